@@ -0,0 +1,161 @@
+/*
+	cancel_check.cpp - Check for the cancellation of group and coroutine calls.
+	
+	Revision 0
+	
+	Features:
+			- Cancels connectServers() on a set of remotes which never reply, and verifies that
+				it returns promptly without connecting to the remotes which no worker got to.
+			- Verifies that playbackStatusAll() with a cancelled flag returns right away.
+			- Verifies that a cancelled coroutine call throws NymphCastCancelled without the call
+				being performed.
+	
+	Notes:
+			- Requires a C++20 compiler for the coroutine header.
+			- Listens on a random port on 127.0.0.1.
+*/
+
+
+#include "../../src/nymphcast_client_coro.h"
+
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/StreamSocket.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// --- SILENT SERVER ---
+// Accepts connections and never replies. Counts the accepted connections.
+struct SilentServer {
+	Poco::Net::ServerSocket socket;
+	std::vector<Poco::Net::StreamSocket> clients;
+	std::atomic<uint32_t> accepted{0};
+	std::atomic<bool> running{true};
+	std::thread thread;
+	
+	SilentServer() : socket(Poco::Net::SocketAddress("127.0.0.1", 0)) {
+		thread = std::thread([this]() {
+			while (running) {
+				if (!socket.poll(Poco::Timespan(0, 20 * 1000), Poco::Net::Socket::SELECT_READ)) {
+					continue;
+				}
+				
+				clients.push_back(socket.acceptConnection());
+				accepted++;
+			}
+		});
+	}
+	
+	~SilentServer() {
+		running = false;
+		thread.join();
+	}
+	
+	uint32_t port() { return socket.address().port(); }
+};
+
+
+// Minimal coroutine type which runs eagerly and is never awaited itself.
+struct CheckTask {
+	struct promise_type {
+		CheckTask get_return_object() { return CheckTask(); }
+		std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+		std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+		void return_void() { }
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+
+// --- AWAIT CANCELLED ---
+// Await a connect on the coroutine client with a cancelled flag. Sets 'thrown' if the call threw
+// NymphCastCancelled.
+static CheckTask awaitCancelled(NymphCastCoroClient& coro, uint32_t port, 
+											std::atomic<bool>& thrown, NymphCancelFlag cancel) {
+	try {
+		co_await coro.connectServerAsync("127.0.0.1", port, cancel);
+	}
+	catch (NymphCastCancelled&) {
+		thrown = true;
+	}
+}
+
+
+// --- ELAPSED ---
+static long elapsed(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+										std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main() {
+	bool ok = true;
+	NymphCastClient client(10000);
+	client.setLogLevel(NYMPH_LOG_LEVEL_CRITICAL);
+	SilentServer server;
+	
+	// Cancel a batch connect after 200 ms. With two workers at most two remotes get connected to.
+	std::vector<NymphCastRemote> remotes(10);
+	for (uint32_t i = 0; i < remotes.size(); ++i) {
+		remotes[i].ipv4 = "127.0.0.1";
+		remotes[i].port = server.port();
+	}
+	
+	NymphCancelFlag cancel = std::make_shared<std::atomic<bool> >(false);
+	std::thread canceller([cancel]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		*cancel = true;
+	});
+	
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<NymphConnectResult> results = client.connectServers(remotes, 2, 10000, cancel);
+	long ms = elapsed(start);
+	canceller.join();
+	
+	uint32_t cancelled = 0;
+	for (uint32_t i = 0; i < results.size(); ++i) {
+		if (!results[i].connected && results[i].error == "Cancelled") { cancelled++; }
+	}
+	
+	std::cout << "connectServers: returned after " << ms << " ms, " << server.accepted
+				<< " accepted, " << cancelled << " cancelled" << std::endl;
+	if (ms > 1000 || server.accepted > 2 || cancelled != results.size()) { ok = false; }
+	
+	// A status snapshot with a cancelled flag returns right away with only stale results.
+	std::vector<uint32_t> handles = { 1, 2, 3, 4 };
+	start = std::chrono::steady_clock::now();
+	std::vector<NymphStatusResult> status = client.playbackStatusAll(handles, 10000, 2, cancel);
+	ms = elapsed(start);
+	
+	uint32_t stale = 0;
+	for (uint32_t i = 0; i < status.size(); ++i) {
+		if (status[i].stale) { stale++; }
+	}
+	
+	std::cout << "playbackStatusAll: returned after " << ms << " ms, " << stale << " stale"
+				<< std::endl;
+	if (ms > 100 || stale != status.size()) { ok = false; }
+	
+	// A cancelled coroutine call throws, without connecting to the server.
+	uint32_t before = server.accepted;
+	std::atomic<bool> thrown{false};
+	NymphCastCoroClient coro(client);
+	awaitCancelled(coro, server.port(), thrown, cancel);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	
+	std::cout << "coroutine: " << (thrown ? "cancelled" : "not cancelled") << ", "
+				<< (server.accepted - before) << " accepted" << std::endl;
+	if (!thrown || server.accepted != before) { ok = false; }
+	
+	if (!ok) {
+		std::cerr << "Unexpected cancellation result." << std::endl;
+		return 1;
+	}
+	
+	return 0;
+}
@@ -0,0 +1,220 @@
+/*
+	nyansd_parse.cpp - Check and benchmark for NyanSD response parsing.
+	
+	Revision 0
+	
+	Features:
+			- Checks that NyanSD::parseResponse() accepts valid responses, including multiple 
+				messages in one datagram and datagrams of the maximum size.
+			- Checks that truncated responses, and responses with lengths exceeding the data, 
+				are rejected without reading past the end of the datagram.
+			- Feeds mutated responses to the parser and times the parsing of a valid response.
+			
+	Notes:
+			- Usage: nyansd_parse [iterations]
+			- Build with ASAN=1 to check for out of bounds reads.
+*/
+
+
+#include "../../src/nyansd.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// --- PUT ---
+// Append a value to the message in little endian (global) byte order.
+static void put(std::string &msg, uint32_t value, uint32_t bytes) {
+	for (uint32_t i = 0; i < bytes; ++i) {
+		msg += (char) ((value >> (i * 8)) & 0xff);
+	}
+}
+
+
+// --- MAKE RESPONSE ---
+// Encode a response message with the provided services, as sent by the NyanSD listener.
+static std::string makeResponse(std::vector<NYSD_service> &services) {
+	std::string body;
+	for (uint32_t i = 0; i < services.size(); ++i) {
+		body += "S";
+		put(body, services[i].ipv4, 4);
+		put(body, services[i].ipv6.length(), 1);
+		body += services[i].ipv6;
+		put(body, services[i].hostname.length(), 2);
+		body += services[i].hostname;
+		put(body, services[i].port, 2);
+		put(body, services[i].protocol, 1);
+		put(body, services[i].service.length(), 2);
+		body += services[i].service;
+	}
+	
+	std::string msg = "NYANSD";
+	put(msg, body.length() + 2, 2);	// Type and service count.
+	put(msg, NYSD_MESSAGE_TYPE_RESPONSE, 1);
+	put(msg, services.size(), 1);
+	msg += body;
+	
+	return msg;
+}
+
+
+// --- MAKE SERVICES ---
+static std::vector<NYSD_service> makeServices(uint32_t count, uint32_t hostlen) {
+	std::vector<NYSD_service> services;
+	for (uint32_t i = 0; i < count; ++i) {
+		NYSD_service sv;
+		sv.ipv4 = 0x0100a8c0 + i;
+		sv.ipv6 = "fe80::1:" + std::to_string(i);
+		sv.hostname = std::string(hostlen, 'h');
+		sv.port = 4004 + i;
+		sv.protocol = NYSD_PROTOCOL_TCP;
+		sv.service = "nymphcast";
+		services.push_back(sv);
+	}
+	
+	return services;
+}
+
+
+// --- PARSE ---
+// Parse the datagram, returning the parse result and the number of services found.
+static bool parse(const std::string &data, uint32_t &found, uint32_t limit = 0) {
+	found = 0;
+	bool stop;
+	NYSD_callback callback = [&found, limit](NYSD_service &service) {
+		found++;
+		return limit == 0 || found < limit;
+	};
+	
+	// Copy into an exactly sized buffer, so that tools like ASan catch reads past its end.
+	std::vector<char> buffer(data.begin(), data.end());
+	return NyanSD::parseResponse(buffer.data(), buffer.size(), callback, stop);
+}
+
+
+static uint32_t failures = 0;
+
+
+// --- CHECK ---
+static void check(bool ok, std::string what) {
+	if (ok) { return; }
+	std::cout << "FAILED: " << what << std::endl;
+	failures++;
+}
+
+
+int main(int argc, char** argv) {
+	uint32_t iterations = 100000;
+	if (argc > 1) { iterations = std::strtoul(argv[1], 0, 10); }
+	if (iterations == 0) { iterations = 1; }
+	
+	// The parser reports every rejected datagram on stderr. Silence it during the checks.
+	std::stringstream discard;
+	std::streambuf* cerrbuf = std::cerr.rdbuf(discard.rdbuf());
+	
+	std::vector<NYSD_service> services = makeServices(3, 16);
+	std::string valid = makeResponse(services);
+	uint32_t found;
+	
+	// Valid responses.
+	NYSD_service last;
+	bool stop;
+	NYSD_callback keep = [&last](NYSD_service &service) {
+		last = service;
+		return true;
+	};
+	
+	check(NyanSD::parseResponse(valid.data(), valid.size(), keep, stop) && 
+			last.ipv4 == services[2].ipv4 && last.ipv6 == services[2].ipv6 && 
+			last.hostname == services[2].hostname && last.port == services[2].port &&
+			last.protocol == services[2].protocol && last.service == services[2].service, 
+			"valid response decodes");
+	check(parse(valid, found) && found == 3, "valid response");
+	check(parse(valid + valid, found) && found == 6, "two responses in one datagram");
+	check(parse(valid, found, 2) && found == 2, "callback ends parsing");
+	
+	std::vector<NYSD_service> large = makeServices(255, 200);
+	std::string largest = makeResponse(large);
+	check(largest.size() < 65536 && parse(largest, found) && found == 255, "maximum response");
+	
+	// Truncated responses. Every prefix of a valid response has to be rejected.
+	uint32_t truncated = 0;
+	for (uint32_t i = 0; i < valid.size(); ++i) {
+		if (!parse(valid.substr(0, i), found) && found < 3) { truncated++; }
+	}
+	
+	check(truncated == valid.size(), "all truncated responses rejected");
+	check(!parse(valid + valid.substr(0, 12), found) && found == 3, "truncated second response");
+	
+	// Oversized lengths, which exceed the data.
+	std::string bad = valid;
+	bad[6] = (char) 0xff;
+	bad[7] = (char) 0xff;
+	check(!parse(bad, found) && found == 0, "message length exceeds datagram");
+	
+	bad = valid;
+	bad[16 + services[0].ipv6.length()] = (char) 0xff;
+	bad[17 + services[0].ipv6.length()] = (char) 0xff;
+	check(!parse(bad, found) && found == 0, "hostname length exceeds message");
+	
+	bad = valid;
+	bad[9] = (char) 0xff;
+	check(!parse(bad, found) && found == 3, "service count exceeds message");
+	
+	bad = valid;
+	bad[0] = 'X';
+	check(!parse(bad, found) && found == 0, "invalid signature");
+	
+	// Randomly mutated responses must not crash or read out of bounds. The parse result isn't
+	// checked, as a mutation can still produce a valid response.
+	std::mt19937 rng(1);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		std::string mutated = valid;
+		uint32_t count = 1 + rng() % 4;
+		for (uint32_t j = 0; j < count; ++j) {
+			mutated[rng() % mutated.size()] = (char) rng();
+		}
+		
+		if (rng() % 4 == 0) { mutated.resize(rng() % mutated.size()); }
+		parse(mutated, found);
+	}
+	
+	double fuzzMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - 
+																					start).count();
+	
+	// Time the parsing of a valid response.
+	NYSD_callback count = [&found](NYSD_service &service) {
+		found++;
+		return true;
+	};
+	
+	found = 0;
+	start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		NyanSD::parseResponse(valid.data(), valid.size(), count, stop);
+	}
+	
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - 
+																				start).count();
+	check(found == iterations * 3, "repeated parsing");
+	
+	std::cerr.rdbuf(cerrbuf);
+	
+	std::cout << iterations << " mutated responses parsed in " << fuzzMs << " ms." << std::endl;
+	std::cout << "Valid response (3 services, " << valid.size() << " bytes): " 
+				<< (ns / iterations) << " ns/parse." << std::endl;
+	if (failures > 0) {
+		std::cout << failures << " check(s) failed." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "All checks passed." << std::endl;
+	
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+	status_decode.cpp - Microbenchmark for decoding playback status structs.
+	
+	Revision 0
+	
+	Features:
+			- Times NymphCastClient::decodeStatus() on a complete status struct, as received
+				with status updates and heartbeat replies.
+			- Times the error path for a struct with a missing field.
+			
+	Notes:
+			- Usage: status_decode [iterations]
+*/
+
+
+#include "../../src/nymphcast_client.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+
+// --- ADD FIELD ---
+// Add a field to the struct map. The key string is owned by its NymphType.
+static void addField(std::map<std::string, NymphPair>* pairs, std::string name, NymphType* value) {
+	NymphPair pair;
+	std::string* key = new std::string(name);
+	pair.key = new NymphType(key, true);
+	pair.value = value;
+	pairs->insert(std::pair<std::string, NymphPair>(*key, pair));
+}
+
+
+// --- MAKE STATUS ---
+// Build a playback status struct like the one sent by a receiver. If 'skip' is not empty, that
+// field is left out.
+static NymphType* makeStatus(std::string artist, std::string title, std::string skip) {
+	std::map<std::string, NymphPair>* pairs = new std::map<std::string, NymphPair>();
+	if (skip != "playing") { addField(pairs, "playing", new NymphType(true)); }
+	if (skip != "status") { addField(pairs, "status", new NymphType((uint32_t) 1)); }
+	if (skip != "duration") { addField(pairs, "duration", new NymphType((uint64_t) 215)); }
+	if (skip != "position") { addField(pairs, "position", new NymphType(42.5)); }
+	if (skip != "volume") { addField(pairs, "volume", new NymphType((uint8_t) 80)); }
+	if (skip != "artist") { addField(pairs, "artist", new NymphType(new std::string(artist), true)); }
+	if (skip != "title") { addField(pairs, "title", new NymphType(new std::string(title), true)); }
+	if (skip != "stopped") { addField(pairs, "stopped", new NymphType(false)); }
+	if (skip != "subtitle_disable") { 
+		addField(pairs, "subtitle_disable", new NymphType(false)); 
+	}
+	
+	return new NymphType(pairs, true);
+}
+
+
+// --- RUN ---
+// Decode the struct 'iterations' times and report the time per decode. Returns the number of 
+// successful decodes.
+static uint32_t run(std::string label, NymphType* nstruct, uint32_t iterations) {
+	NymphPlaybackStatus stat;
+	std::string missing;
+	uint32_t decoded = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		if (NymphCastClient::decodeStatus(nstruct, stat, missing)) { decoded++; }
+	}
+	
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - 
+																					start).count();
+	std::cout << label << ": " << iterations << " decodes, " << (ns / iterations) 
+				<< " ns/decode, " << decoded << " succeeded";
+	if (decoded != iterations) { std::cout << " (missing '" << missing << "')"; }
+	std::cout << std::endl;
+	
+	return decoded;
+}
+
+
+int main(int argc, char** argv) {
+	uint32_t iterations = 1000000;
+	if (argc > 1) { iterations = std::strtoul(argv[1], 0, 10); }
+	if (iterations == 0) { iterations = 1; }
+	
+	NymphType* full = makeStatus("Some Artist", "Some rather long track title (Remastered)", "");
+	NymphType* partial = makeStatus("Some Artist", "Some Title", "subtitle_disable");
+	
+	bool ok = true;
+	if (run("complete struct", full, iterations) != iterations) { ok = false; }
+	if (run("missing field", partial, iterations) != 0) { ok = false; }
+	
+	// Verify the decoded values once.
+	NymphPlaybackStatus stat;
+	std::string missing;
+	if (!NymphCastClient::decodeStatus(full, stat, missing) || stat.error || !stat.playing || 
+			stat.duration != 215 || stat.volume != 80 || stat.title.empty()) {
+		ok = false;
+	}
+	
+	delete full;
+	delete partial;
+	
+	if (!ok) {
+		std::cerr << "Unexpected decode result." << std::endl;
+		return 1;
+	}
+	
+	return 0;
+}
@@ -16,8 +16,13 @@
 
 #include <iostream>
 #include <map>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <string_view>
 
 #include <Poco/Net/DatagramSocket.h>
+#include <Poco/Net/MulticastSocket.h>
 #include <Poco/Net/NetworkInterface.h>
 #include <Poco/Net/DNS.h>
 #include <Poco/Net/NetException.h>
@@ -29,18 +34,48 @@ std::vector<NYSD_service> NyanSD::services;
 std::mutex NyanSD::servicesMutex;
 std::atomic<bool> NyanSD::running{false};
 std::thread NyanSD::handler;
+std::unique_ptr<Poco::Net::DatagramSocket> NyanSD::wakeupSocket;
+std::map<std::string, std::chrono::steady_clock::time_point> NyanSD::recentQueries;
+std::map<std::string, NYSD_bucket> NyanSD::buckets;
+std::atomic<uint32_t> NyanSD::dedupWindow{250};
+std::atomic<double> NyanSD::rateLimit{5.0};
+std::atomic<uint32_t> NyanSD::rateBurst{10};
+NyanSD::ListenerCounters NyanSD::stats;
+std::atomic<uint32_t> NyanSD::servicesGeneration{0};
+std::map<std::string, NYSD_response> NyanSD::responseCache;
+std::vector<NYSD_interface> NyanSD::interfaces;
+std::mutex NyanSD::interfacesMutex;
+std::chrono::steady_clock::time_point NyanSD::interfacesUpdated;
+bool NyanSD::interfacesValid = false;
+NYSD_ifwatch NyanSD::ifwatch;
 ByteBauble NyanSD::bb;
 
 
-struct ResponseStruct {
-	char* data;
-	uint32_t length;
-};
+// --- SEND QUERY ---
+bool NyanSD::sendQuery(uint16_t port, std::vector<NYSD_query> queries, 
+									std::vector<NYSD_service> &responses, bool multicast) {
+	return sendQuery(port, queries, [&responses](NYSD_service &service) {
+		responses.push_back(service);
+		return true;
+	}, multicast);
+}
 
 
 // --- SEND QUERY ---
-bool NyanSD::sendQuery(uint16_t port, std::vector<NYSD_query> queries, 
-									std::vector<NYSD_service> &responses) {
+bool NyanSD::sendQuery(uint16_t port, std::vector<NYSD_query> queries, NYSD_callback callback,
+																				bool multicast) {
+	return sendQuery(std::vector<uint16_t>(1, port), queries, callback, multicast);
+}
+
+
+// --- SEND QUERY ---
+// Streaming version. The callback is called for each service as its response is received. 
+// Returning false from the callback ends the query before the response window has passed.
+// If 'multicast' is set, the query is sent to the NyanSD multicast groups instead of being 
+// broadcast on each interface. Each of the provided ports gets the queries for that port, with
+// the responses to all of them received in the same response window.
+bool NyanSD::sendQuery(std::vector<uint16_t> ports, std::vector<NYSD_query> queries, 
+										NYSD_callback callback, bool multicast) {
 	if (queries.size() > 255) {
 		std::cerr << "No more than 255 queries can be send simultaneously." << std::endl;
 		return false;
@@ -49,17 +84,94 @@ bool NyanSD::sendQuery(uint16_t port, std::vector<NYSD_query> queries,
 		std::cerr << "At least one query must be sent. No query found." << std::endl;
 		return false;
 	}
-				
-	// Compose the NYSD message.
+	
+	// Compose the NYSD message for each port. Ports without any queries are skipped.
+	std::vector<uint16_t> msgPorts;
+	std::vector<std::string> msgs;
+	for (uint32_t i = 0; i < ports.size(); ++i) {
+		std::string msg = buildQuery(queries, ports[i]);
+		if (msg.empty()) { continue; }
+		msgPorts.push_back(ports[i]);
+		msgs.push_back(msg);
+	}
+	
+	if (msgs.empty()) {
+		std::cerr << "No query found for any of the ports." << std::endl;
+		return false;
+	}
+	
+	// Send the query. All sockets used are then listened on together, so that the response 
+	// window doesn't scale with the interface count.
+	Poco::Net::Socket::SocketList sockets;
+	if (multicast) {
+		multicastQuery(msgs, msgPorts, sockets);
+	}
+	else {
+		broadcastQuery(msgs, msgPorts, sockets);
+	}
+	
+#ifdef DEBUG
+	std::cout << "Listening on " << sockets.size() << " socket(s)..." << std::endl;
+#endif
+	
+	// Listen for responses on all sockets for 500 milliseconds in total. Each response is parsed
+	// and passed on as soon as it is received. All datagrams are received into the same arena,
+	// which is allocated once per thread and sized for the largest possible datagram.
+	static thread_local std::vector<char> arena(65536);
+	bool done = false;
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + 
+														std::chrono::milliseconds(500);
+	while (!done && !sockets.empty()) {
+		int64_t remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+										end - std::chrono::steady_clock::now()).count();
+		if (remaining <= 0) { break; }
+		
+		// Select replaces the contents of the lists with the ready sockets.
+		Poco::Net::Socket::SocketList readList(sockets), writeList, exceptList;
+		Poco::Timespan ts(remaining);
+		if (Poco::Net::Socket::select(readList, writeList, exceptList, ts) == 0) { break; }
+		
+		for (uint32_t i = 0; i < readList.size() && !done; ++i) {
+			Poco::Net::DatagramSocket udpsocket(readList[i]);
+			int n = 0;
+			try {
+				n = udpsocket.receiveBytes(arena.data(), arena.size(), 0);
+			}
+			catch (...) {
+				std::cerr << "ReceiveBytes: Unknown exception." << std::endl;
+				continue;
+			}
+			
+#ifdef DEBUG
+			std::cout << "Received message with length " << n << std::endl;
+#endif
+			
+			parseResponse(arena.data(), n, callback, done);
+		}
+	}
+	
+	// Close the sockets as we're done with the interfaces.
+	for (uint32_t i = 0; i < sockets.size(); ++i) {
+		sockets[i].close();
+	}
+	
+	return true;
+}
+
+
+// --- BUILD QUERY ---
+// Compose the query message with the queries for the port. Returns an empty string if there are
+// no queries for the port.
+std::string NyanSD::buildQuery(std::vector<NYSD_query> &queries, uint16_t port) {
 	BBEndianness he = bb.getHostEndian();
 	std::string msg = "NYANSD";
 	uint16_t len = 0;
 	uint8_t type = (uint8_t) NYSD_MESSAGE_TYPE_BROADCAST;
 	
 	std::string body;
-	uint8_t qnum = queries.size();
-	body += std::string((char*) &qnum, 1);
-	for (int i = 0; i < qnum; ++i) {
+	uint8_t qnum = 0;
+	for (uint32_t i = 0; i < queries.size(); ++i) {
+		if (queries[i].port != 0 && queries[i].port != port) { continue; }
 		body += std::string("Q");
 		uint8_t prot = (uint8_t) queries[i].protocol;
 		uint8_t qlen = (uint8_t) queries[i].filter.length();
@@ -68,8 +180,13 @@ bool NyanSD::sendQuery(uint16_t port, std::vector<NYSD_query> queries,
 		if (qlen > 0) {
 			body += queries[i].filter;
 		}
+		
+		qnum++;
 	}
 	
+	if (qnum == 0) { return std::string(); }
+	
+	body.insert(0, 1, (char) qnum);
 	len = body.length() + 1;	// Add one byte for the message type.
 	len = bb.toGlobal(len, he);
 	msg += std::string((char*) &len, 2);
@@ -77,57 +194,32 @@ bool NyanSD::sendQuery(uint16_t port, std::vector<NYSD_query> queries,
 	msg += body;
 	
 #ifdef DEBUG
-	std::cout << "Message length: " << msg.length() << std::endl;
+	std::cout << "Message length for port " << port << ": " << msg.length() << std::endl;
 #endif
 	
-	// Open UDP socket for each interface and send the broadcast message.
-	std::vector<ResponseStruct> buffers;
-	std::map<uint32_t, Poco::Net::NetworkInterface> interfaces = Poco::Net::NetworkInterface::map(true, true);
-	uint32_t ifc_size = interfaces.size();
+	return msg;
+}
+
+
+// --- BROADCAST QUERY ---
+// Open a UDP socket for each interface and send the message for each port to the interface's 
+// broadcast address. The sockets are added to the provided list.
+void NyanSD::broadcastQuery(std::vector<std::string> &msgs, std::vector<uint16_t> &ports, 
+											Poco::Net::Socket::SocketList &sockets) {
+	std::vector<NYSD_interface> ifcs = getInterfaces();
 	
 #ifdef DEBUG
-	std::cout << "Found " << ifc_size << " network interfaces." << std::endl;
+	std::cout << "Found " << ifcs.size() << " interface addresses." << std::endl;
 #endif
 	
-	std::map<uint32_t, Poco::Net::NetworkInterface>::const_iterator it;
-	for (it = interfaces.begin(); it != interfaces.end(); ++it) {
-		const Poco::Net::NetworkInterface& ifc = it->second;
-		
-#ifdef DEBUG
-		std::cout << "Network interface '" << ifc.displayName() << "'." << std::endl;
-#endif
-		
-		if (!ifc.supportsIPv4()) {
-			std::cerr << "Network interface " << it->first << " does not support IPv4." << std::endl;
-			continue; 
-		}
-		
-		Poco::Net::IPAddress ip;
-		try {
-			ip = ifc.firstAddress(Poco::Net::IPAddress::IPv4);
-		}
-		catch (Poco::NotFoundException &e) {
-			std::cerr << "Received NotFoundException: " << e.displayText() << std::endl;
-			continue;
-		}
-		catch (...) {
-			std::cerr << "Received unknown exception." << std::endl;
-			continue;
-		}
-		
-		if (!ip.isIPv4Compatible()) {
-			std::cerr << "Not an IPv4 IP, skipping." << std::endl;
-			continue;
-		}
-		
-		std::string ipStr = ip.toString();
-		
-#ifdef DEBUG
-		std::cout << "Modifying IP address: " << ipStr << std::endl;
-#endif
+	// Use the broadcast address of each interface's first IPv4 subnet.
+	std::vector<unsigned> done;
+	for (uint32_t i = 0; i < ifcs.size(); ++i) {
+		if (ifcs[i].address.family() != Poco::Net::IPAddress::IPv4) { continue; }
+		if (std::find(done.begin(), done.end(), ifcs[i].index) != done.end()) { continue; }
+		done.push_back(ifcs[i].index);
 		
-		// Replace the last digits with '255' to make it into a broadcast address.
-		ipStr.replace(ipStr.find_last_of('.') + 1, 3, "255");
+		std::string ipStr = ifcs[i].broadcast.toString();
 		
 #ifdef DEBUG
 		std::cout << "Broadcast IP address: " << ipStr << std::endl;
@@ -135,14 +227,16 @@ bool NyanSD::sendQuery(uint16_t port, std::vector<NYSD_query> queries,
 		
 		Poco::Net::DatagramSocket udpsocket(Poco::Net::IPAddress::IPv4);
 		udpsocket.setBroadcast(true);
-		Poco::Net::SocketAddress sa(ipStr, port);
 		
 #ifdef DEBUG
 		std::cout << "Sending..." << std::endl;
 #endif
 		
 		try {
-			udpsocket.sendTo(msg.data(), msg.length(), sa);
+			for (uint32_t j = 0; j < ports.size(); ++j) {
+				Poco::Net::SocketAddress sa(ipStr, ports[j]);
+				udpsocket.sendTo(msgs[j].data(), msgs[j].length(), sa);
+			}
 		}
 		catch (Poco::Net::NetException &e) {
 			std::cerr << "UDP Socket sendTo: got exception - " << e.displayText() << std::endl;
@@ -153,169 +247,224 @@ bool NyanSD::sendQuery(uint16_t port, std::vector<NYSD_query> queries,
 			continue;
 		}
 		
-#ifdef DEBUG
-		std::cout << "Listening..." << std::endl;
-#endif
+		sockets.push_back(udpsocket);
+	}
+}
+
+
+// --- MULTICAST QUERY ---
+// Send the message for each port to the NyanSD IPv4 and IPv6 multicast groups on each 
+// multicast-capable interface. Without selecting the interface, only the one of the default route would be used,
+// and the link-local IPv6 group has no meaning without one. The sockets are added to the 
+// provided list.
+void NyanSD::multicastQuery(std::vector<std::string> &msgs, std::vector<uint16_t> &ports, 
+											Poco::Net::Socket::SocketList &sockets) {
+	std::vector<NYSD_interface> ifcs = getInterfaces();
+	std::vector<unsigned> done4;
+	std::vector<unsigned> done6;
+	for (uint32_t i = 0; i < ifcs.size(); ++i) {
+		bool v4 = ifcs[i].address.family() == Poco::Net::IPAddress::IPv4;
+		std::vector<unsigned>& done = v4 ? done4 : done6;
+		if (std::find(done.begin(), done.end(), ifcs[i].index) != done.end()) { continue; }
+		done.push_back(ifcs[i].index);
 		
-		// Listen for responses for 500 milliseconds.
-		Poco::Timespan ts(500000);	// 500 ms timeout.
-		int n;
-		Poco::Net::Socket::SocketList readList, writeList, exceptList;
-		readList.push_back(udpsocket);
-		while (Poco::Net::Socket::select(readList, writeList, exceptList, ts)) {
-			ResponseStruct rs;
-			rs.data = new char[2048];
-			try {
-				rs.length = udpsocket.receiveBytes(rs.data, 2048, 0);
-			}
-			catch (Poco::TimeoutException &exc) {
-				std::cerr << "ReceiveBytes: " << exc.displayText() << std::endl;
-				udpsocket.close();
-				continue;
-			}
-			catch (...) {
-				std::cerr << "ReceiveBytes: Unknown exception." << std::endl;
-				continue;
-			}
+		const char* group = v4 ? NYSD_MULTICAST_IPV4 : NYSD_MULTICAST_IPV6;
+		try {
+			Poco::Net::NetworkInterface ifc = Poco::Net::NetworkInterface::forIndex(ifcs[i].index);
+			if (!ifc.supportsMulticast()) { continue; }
 			
 #ifdef DEBUG
-			std::cout << "Received message with length " << rs.length << std::endl;
+			std::cout << "Multicast on interface: " << ifc.name() << std::endl;
 #endif
 			
-			buffers.push_back(rs);
+			Poco::Net::MulticastSocket udpsocket(ifcs[i].address.family());
+			udpsocket.setInterface(ifc);
+			udpsocket.setTimeToLive(1);
+			for (uint32_t j = 0; j < ports.size(); ++j) {
+				Poco::Net::SocketAddress sa(group, ports[j]);
+				udpsocket.sendTo(msgs[j].data(), msgs[j].length(), sa);
+			}
+			
+			sockets.push_back(udpsocket);
+		}
+		catch (Poco::Exception &e) {
+			std::cerr << "Multicast sendTo " << group << " on interface " << ifcs[i].index 
+						<< ": got exception - " << e.displayText() << std::endl;
 		}
+	}
+}
+
+
+// --- JOIN GROUP ---
+// Join the multicast group on each multicast-capable interface of the group's address family.
+// Returns false if the group couldn't be joined on any interface.
+static bool joinGroup(Poco::Net::MulticastSocket &socket, Poco::Net::IPAddress group) {
+	bool joined = false;
+	std::map<uint32_t, Poco::Net::NetworkInterface> interfaces = Poco::Net::NetworkInterface::map(true, true);
+	std::map<uint32_t, Poco::Net::NetworkInterface>::const_iterator it;
+	for (it = interfaces.begin(); it != interfaces.end(); ++it) {
+		const Poco::Net::NetworkInterface& ifc = it->second;
+		if (!ifc.supportsMulticast()) { continue; }
+		if (group.family() == Poco::Net::IPAddress::IPv4 && !ifc.supportsIPv4()) { continue; }
+		if (group.family() == Poco::Net::IPAddress::IPv6 && !ifc.supportsIPv6()) { continue; }
 		
-		// Close socket as we're done with this interface.
-		udpsocket.close();
+		try {
+			socket.joinGroup(group, ifc);
+			joined = true;
+		}
+		catch (Poco::Exception &e) {
+			std::cerr << "Failed to join multicast group " << group.toString() << " on " 
+						<< ifc.name() << ": " << e.displayText() << std::endl;
+		}
+	}
+	
+	return joined;
+}
+
+
+// Bounds-checked reader for received NYSD messages. Once a read would run past the end of the
+// data, 'ok' is cleared and all further reads return zero or empty values.
+struct NYSD_reader {
+	const char* data;
+	uint32_t size;
+	uint32_t index = 0;
+	bool ok = true;
+	
+	NYSD_reader(const char* data, uint32_t size) : data(data), size(size) { }
+	
+	bool need(uint32_t n) {
+		if (!ok || n > size - index) { ok = false; }
+		return ok;
 	}
 	
+	uint8_t u8() {
+		if (!need(1)) { return 0; }
+		return (uint8_t) data[index++];
+	}
+	
+	template<typename T> T value() {
+		T out = 0;
+		if (!need(sizeof(T))) { return out; }
+		memcpy(&out, data + index, sizeof(T));
+		index += sizeof(T);
+		return out;
+	}
+	
+	std::string_view bytes(uint32_t n) {
+		if (!need(n)) { return std::string_view(); }
+		std::string_view out(data + index, n);
+		index += n;
+		return out;
+	}
+};
+
+
+// --- PARSE RESPONSE ---
+// Parse the response messages in a received datagram, passing each service found to the 
+// callback. Returns false if the datagram was invalid. Services parsed before the error was 
+// found have already been passed on. 'stop' is set if the callback returned false.
+//
+// The service passed to the callback is reused for each service parsed on this thread. Its 
+// strings keep their capacity, so that parsing doesn't allocate once they are large enough.
+bool NyanSD::parseResponse(const char* buffer, uint32_t n, NYSD_callback &callback, bool &stop) {
+	static thread_local NYSD_service sv;
+	NYSD_reader rd(buffer, n);
+	stop = false;
+	if (n < 8) {
+		// Nothing to do.	
 #ifdef DEBUG
-	std::cout << "Parsing " << buffers.size() << " response(s)..." << std::endl;
+		std::cout << "No responses were received." << std::endl;
 #endif
+		return false;
+	}
 	
-	// Copy parsed responses into the 'responses' vector.
-	for (int i = 0; i < buffers.size(); ++i) {
-		int n = buffers[i].length;
-		if (n < 8) {
-			// Nothing to do.	
+	// The received data can contain more than one response. Start parsing from the beginning until
+	// we are done.
+	while (rd.index < n) {
+		std::string_view signature = rd.bytes(6);
+		if (signature != "NYANSD") {
+			std::cerr << "Signature of message incorrect: " << signature << std::endl;
+			return false;
+		}
+		
+		uint16_t len = bb.toHost(rd.value<uint16_t>(), BB_LE);
+		if (!rd.need(len) || len < 1) {
+			std::cerr << "Insufficient data in buffer to finish parsing message: " << len << "/" 
+						<< (n - rd.index) << std::endl;
+			return false;
+		}
+		
 #ifdef DEBUG
-			std::cout << "No responses were received." << std::endl;
+		std::cout << "Found message with length: " << len << std::endl;
 #endif
-			return false;
+		
+		// Restrict the reader to this message.
+		NYSD_reader msg(buffer + rd.index, len);
+		rd.index += len;
+		
+		uint8_t type = msg.u8();
+		
+#ifdef DEBUG
+		std::cout << "Message type: " << (uint16_t) type << std::endl;
+#endif
+		
+		if (type != NYSD_MESSAGE_TYPE_RESPONSE) {
+			std::cerr << "Not a response message type. Skipping..." << std::endl;
+			continue;
 		}
 		
-		// The received data can contain more than one response. Start parsing from the beginning until
-		// we are done.
-		char* buffer = buffers[i].data;
-		int index = 0;
-		while (index < n) {
-			std::string signature = std::string(buffer, 6);
-			index += 6;
-			if (signature != "NYANSD") {
-				std::cerr << "Signature of message incorrect: " << signature << std::endl;
-				return false;
-			}
-			
-			len = *((uint16_t*) &buffer[index]);
-			len = bb.toHost(len, BB_LE);
-			index += 2;
-			
-			if (len > buffers[i].length - (index)) {
-				std::cerr << "Insufficient data in buffer to finish parsing message: " << len << "/" 
-							<< (buffers[i].length - (index + 6)) << std::endl;
-				return false;
-			}
-			
+		uint8_t rnum = msg.u8();
 #ifdef DEBUG
-			std::cout << "Found message with length: " << len << std::endl;
+		std::cout << "Response count: " << (uint16_t) rnum << std::endl;
 #endif
+		
+		// Service sections.
+		for (int i = 0; i < rnum; ++i) {
+			if (msg.u8() != 'S') {
+				std::cerr << "Invalid service section signature. Aborting parsing." << std::endl;
+				return false;
+			}
 			
-			type = *((uint8_t*) &buffer[index++]);
+			sv.ipv4 = bb.toHost(msg.value<uint32_t>(), BB_LE);
+			uint8_t ipv6len = msg.u8();
 			
 #ifdef DEBUG
-			std::cout << "Message type: " << (uint16_t) type << std::endl;
+			std::cout << "IPv6 string with length: " << (uint16_t) ipv6len << std::endl;
 #endif
 			
-			if (type != NYSD_MESSAGE_TYPE_RESPONSE) {
-				std::cerr << "Not a response message type. Skipping..." << std::endl;
-				continue;
+			sv.ipv6.assign(msg.bytes(ipv6len));
+			uint16_t hostlen = bb.toHost(msg.value<uint16_t>(), BB_LE);
+			sv.hostname.assign(msg.bytes(hostlen));
+			sv.port = bb.toHost(msg.value<uint16_t>(), BB_LE);
+			uint8_t prot = msg.u8();
+			uint16_t snlen = bb.toHost(msg.value<uint16_t>(), BB_LE);
+			sv.service.assign(msg.bytes(snlen));
+			if (!msg.ok) {
+				std::cerr << "Truncated service section. Aborting parsing." << std::endl;
+				return false;
 			}
 			
-			uint8_t rnum = *((char*) &buffer[index++]);		
 #ifdef DEBUG
-			std::cout << "Response count: " << (uint16_t) rnum << std::endl;
+			std::cout << "Adding service with name: " << sv.service << std::endl;
 #endif
 			
-			// Service sections.
-			for (int i = 0; i < rnum; ++i) {
-				if (buffer[index] != 'S' != 0) {
-					std::cerr << "Invalid service section signature. Aborting parsing." << std::endl;
-					return false;
-				}
-				
-				index++;
-				uint32_t ipv4 = *((uint32_t*) &buffer[index]);
-				ipv4 = bb.toHost(ipv4, BB_LE);
-				index += 4;
-				
-				uint8_t ipv6len = *((uint8_t*) &buffer[index++]);
-				
-#ifdef DEBUG
-				std::cout << "IPv6 string with length: " << (uint16_t) ipv6len << std::endl;
-#endif
-				
-				std::string ipv6 = std::string(buffer + index, buffer + (index + ipv6len));
-				index += ipv6len;
-				
-				uint16_t hostlen = *((uint16_t*) &buffer[index]);
-				hostlen = bb.toHost(hostlen, BB_LE);
-				index += 2;
-				
-				std::string hostname = std::string(buffer + index, buffer + (index + hostlen));
-				index += hostlen;
-				
-				uint16_t port = *((uint16_t*) &buffer[index]);
-				port = bb.toHost(port, BB_LE);
-				index += 2;
-				
-				uint8_t prot = *((uint8_t*) &buffer[index++]);
-				
-				uint16_t snlen = *((uint16_t*) &buffer[index]);
-				snlen = bb.toHost(snlen, BB_LE);
-				index += 2;
-				
-				std::string svname = std::string(buffer + index, buffer + (index + snlen));
-				index += snlen;
-				
-#ifdef DEBUG
-				std::cout << "Adding service with name: " << svname << std::endl;
-#endif
-				
-				NYSD_service sv;
-				sv.ipv4 = ipv4;
-				sv.ipv6 = ipv6;
-				sv.port = port;
-				sv.hostname = hostname;
-				sv.service = svname;
-				if (prot == NYSD_PROTOCOL_ALL) {
-					sv.protocol = NYSD_PROTOCOL_ALL;
-				}
-				else if (prot == NYSD_PROTOCOL_TCP) {
-					sv.protocol = NYSD_PROTOCOL_TCP;
-				}
-				else if (prot == NYSD_PROTOCOL_UDP) {
-					sv.protocol = NYSD_PROTOCOL_UDP;
-				}
-				
-				responses.push_back(sv);
+			sv.protocol = NYSD_PROTOCOL_ALL;
+			if (prot == NYSD_PROTOCOL_TCP) {
+				sv.protocol = NYSD_PROTOCOL_TCP;
+			}
+			else if (prot == NYSD_PROTOCOL_UDP) {
+				sv.protocol = NYSD_PROTOCOL_UDP;
 			}
 			
+			if (!callback(sv)) {
+				stop = true;
+				return true;
+			}
+		}
+		
 #ifdef DEBUG
-			std::cout << "Buffer: " << index << "/" << n << std::endl;
+		std::cout << "Buffer: " << rd.index << "/" << n << std::endl;
 #endif
-		}
-			
-		delete[] buffers[i].data;
 	}
 	
 	return true;
@@ -338,6 +487,7 @@ bool NyanSD::addService(NYSD_service service) {
 	
 	servicesMutex.lock();
 	services.push_back(service);
+	servicesGeneration++;
 	servicesMutex.unlock();
 	
 	return true;
@@ -345,14 +495,29 @@ bool NyanSD::addService(NYSD_service service) {
 
 
 // --- START LISTENER ---
-bool NyanSD::startListener(uint16_t port) {
+// If 'multicast' is set, the listener also joins the NyanSD multicast groups. Broadcast queries 
+// are always answered.
+bool NyanSD::startListener(uint16_t port, bool multicast) {
 	if (running) {
 		std::cerr << "Client handler thread is already running." << std::endl;
 		return false;
 	}
 	
+	// Set up the loopback socket used to wake the client handler when stopping. It is only 
+	// created here, after the network has been initialised.
+	try {
+		wakeupSocket.reset(new Poco::Net::DatagramSocket(Poco::Net::IPAddress::IPv4));
+		wakeupSocket->bind(Poco::Net::SocketAddress("127.0.0.1", 0));
+	}
+	catch (Poco::Exception &e) {
+		std::cerr << "Failed to create listener wakeup socket: " << e.displayText() << std::endl;
+		wakeupSocket.reset();
+		return false;
+	}
+	
 	// Create new thread with the client handler.
-	handler = std::thread(&NyanSD::clientHandler, port);
+	running = true;
+	handler = std::thread(&NyanSD::clientHandler, port, multicast);
 	
 	return true;
 }
@@ -360,9 +525,27 @@ bool NyanSD::startListener(uint16_t port) {
 
 // --- STOP LISTENER ---
 bool NyanSD::stopListener() {
-	// Stop the listening socket and clean-up resources.
+	if (!handler.joinable()) { return false; }
+	
+	// Stop the listening socket and clean-up resources. The client handler is woken up by sending
+	// a datagram to its wakeup socket.
 	running = false;
+	try {
+		Poco::Net::DatagramSocket udpsocket(Poco::Net::IPAddress::IPv4);
+		char c = 0;
+		udpsocket.sendTo(&c, 1, wakeupSocket->address());
+	}
+	catch (Poco::Exception &e) {
+		std::cerr << "Failed to wake up listener: " << e.displayText() << std::endl;
+	}
+	
 	handler.join();
+	wakeupSocket.reset();
+	
+	// Stop receiving interface notifications until the interface table is used again.
+	interfacesMutex.lock();
+	ifwatch.close();
+	interfacesMutex.unlock();
 	
 	return true;
 }
@@ -404,92 +587,416 @@ uint32_t NyanSD::ipv4_stringToUint(std::string ipv4) {
 }
 
 
-// --- REMOTE TO LOCAL IP ---
-bool remoteToLocalIP(Poco::Net::SocketAddress &sa, uint32_t &ipv4, std::string &ipv6) {
-	std::map<unsigned, Poco::Net::NetworkInterface> map = Poco::Net::NetworkInterface::map(true, false);
-	std::map<unsigned, Poco::Net::NetworkInterface>::const_iterator it = map.begin();
-	std::map<unsigned, Poco::Net::NetworkInterface>::const_iterator end = map.end();
+// --- REFRESH INTERFACES ---
+// Rebuild the interface table. The interfaces mutex must be held by the caller.
+void NyanSD::refreshInterfaces() {
+	interfaces.clear();
+	std::map<unsigned, Poco::Net::NetworkInterface> map;
+	try {
+		map = Poco::Net::NetworkInterface::map(true, true);
+	}
+	catch (Poco::Exception &e) {
+		std::cerr << "Failed to obtain network interfaces: " << e.displayText() << std::endl;
+	}
+	
+	std::map<unsigned, Poco::Net::NetworkInterface>::const_iterator it;
+	for (it = map.begin(); it != map.end(); ++it) {
+		const Poco::Net::NetworkInterface::AddressList& addresses = it->second.addressList();
+		for (uint32_t i = 0; i < addresses.size(); ++i) {
+			NYSD_interface ifc;
+			ifc.index = it->second.index();
+			ifc.address = std::get<Poco::Net::NetworkInterface::IP_ADDRESS>(addresses[i]);
+			ifc.mask = std::get<Poco::Net::NetworkInterface::SUBNET_MASK>(addresses[i]);
+			ifc.broadcast = std::get<Poco::Net::NetworkInterface::BROADCAST_ADDRESS>(addresses[i]);
+			
+			// Without subnet information, assume a /24 or /64 subnet.
+			if (ifc.mask.isWildcard() || ifc.mask.family() != ifc.address.family()) {
+				bool v4 = ifc.address.family() == Poco::Net::IPAddress::IPv4;
+				ifc.mask = Poco::Net::IPAddress(v4 ? 24 : 64, ifc.address.family());
+			}
+			
+			// Derive the broadcast address from the subnet mask if none was provided.
+			if (ifc.address.family() == Poco::Net::IPAddress::IPv4 && 
+					(ifc.broadcast.isWildcard() || 
+						ifc.broadcast.family() != Poco::Net::IPAddress::IPv4)) {
+				ifc.broadcast = ifc.address | ~ifc.mask;
+			}
+			
+			interfaces.push_back(ifc);
+		}
+	}
+	
+	interfacesUpdated = std::chrono::steady_clock::now();
+	interfacesValid = true;
+	
+	// Cached responses may contain addresses which changed.
+	servicesGeneration++;
+}
 
-	bool isIPv6 = true;
-	if (sa.family() == Poco::Net::IPAddress::IPv4) { isIPv6 = false; }
+
+// --- GET INTERFACES ---
+// Return the interface table, refreshing it first if the interfaces changed or it expired.
+std::vector<NYSD_interface> NyanSD::getInterfaces() {
+	interfacesMutex.lock();
+	updateInterfaces();
+	std::vector<NYSD_interface> out = interfaces;
+	interfacesMutex.unlock();
 	
-	std::string addr = sa.toString();
-#ifdef DEBUG
-	std::cout << "Sender was IP: " << addr << std::endl;
-#endif
-	if (isIPv6) {
-		addr.erase(addr.find_last_of(':') + 1);
+	return out;
+}
+
+
+// --- UPDATE INTERFACES ---
+// Refresh the interface table if needed. The interfaces mutex must be held by the caller.
+void NyanSD::updateInterfaces() {
+	bool changed = ifwatch.changed();
+	if (!interfacesValid || changed || 
+		std::chrono::steady_clock::now() - interfacesUpdated > std::chrono::seconds(30)) {
+		refreshInterfaces();
 	}
-	else {
-		addr.erase(addr.find_last_of('.') + 1);
+}
+
+
+// --- SAME SUBNET ---
+// Compare the addresses under the mask. The scope of IPv6 addresses is ignored.
+static bool sameSubnet(const Poco::Net::IPAddress &a, const Poco::Net::IPAddress &b, 
+												const Poco::Net::IPAddress &mask) {
+	if (a.length() != b.length() || a.length() != mask.length()) { return false; }
+	const uint8_t* pa = (const uint8_t*) a.addr();
+	const uint8_t* pb = (const uint8_t*) b.addr();
+	const uint8_t* pm = (const uint8_t*) mask.addr();
+	for (int i = 0; i < a.length(); ++i) {
+		if ((pa[i] & pm[i]) != (pb[i] & pm[i])) { return false; }
 	}
 	
+	return true;
+}
+
+
+// --- REMOTE TO LOCAL IP ---
+// Find the address of the local interface which is on the same subnet as the remote address.
+// Link-local IPv6 addresses are on the same subnet on every interface, so for those the 
+// interface has to match the scope of the remote address as well.
+bool NyanSD::remoteToLocalIP(Poco::Net::SocketAddress &sa, uint32_t &ipv4, std::string &ipv6) {
+	Poco::Net::IPAddress remote = sa.host();
+	
+#ifdef DEBUG
+	std::cout << "Sender was IP: " << remote.toString() << std::endl;
+#endif
+	
+	interfacesMutex.lock();
+	updateInterfaces();
+	for (uint32_t i = 0; i < interfaces.size(); ++i) {
+		const NYSD_interface& ifc = interfaces[i];
+		if (ifc.address.family() != remote.family()) { continue; }
+		if (!sameSubnet(ifc.address, remote, ifc.mask)) { continue; }
+		if (remote.family() == Poco::Net::IPAddress::IPv6 && remote.isLinkLocal() && 
+								remote.scope() != 0 && remote.scope() != ifc.index) { continue; }
+		
 #ifdef DEBUG
-	std::cout << "LAN base IP: " << addr << std::endl;
+		std::cout << "Found IP: " << ifc.address.toString() << std::endl;
 #endif
-	for (; it != end; ++it) {
-		const std::size_t count = it->second.addressList().size();
-		for (int i = 0; i < count; ++i) {
-			std::string ip = it->second.address(i).toString();
+		
+		if (remote.family() == Poco::Net::IPAddress::IPv4) {
+			ipv4 = ipv4_stringToUint(ifc.address.toString());
+		}
+		else {
+			ipv6 = ifc.address.toString();
 			
+			// Remove trailing '%<if>' section on certain OSes.
+			std::string::size_type st = ipv6.find_last_of('%');
+			if (st != std::string::npos) { ipv6.erase(st); }
+		}
+		
+		interfacesMutex.unlock();
+		return true;
+	}
+	
+	interfacesMutex.unlock();
+	
 #ifdef DEBUG
-			std::cout << "Checking IP: " << ip << std::endl;
+	std::cout << "LAN IP not found on interfaces." << std::endl;
 #endif
-			if (addr.compare(0, addr.length(), ip, 0, addr.length()) == 0) {
+	
+	return false;
+}
+
+
+// --- BUILD RESPONSE ---
+// Assemble the response message for a query. An empty filter matches all services. Services 
+// without an IPv4 address get the provided address of the local interface on the sender's 
+// network, or are left out if 'localFound' is false.
+std::string NyanSD::buildResponse(std::string_view filter, bool localFound, uint32_t localIpv4, 
+														const std::string &localIpv6) {
+	BBEndianness he = bb.getHostEndian();
+	std::string servicesBody;
+	uint8_t scount = 0;
+	
+	servicesMutex.lock();
+	for (uint32_t i = 0; i < services.size() && scount < 255; ++i) {
+		if (!filter.empty() && filter != services[i].service) { continue; }
+		
+		uint32_t ipv4 = services[i].ipv4;
+		const std::string* ipv6 = &services[i].ipv6;
+		if (ipv4 == 0) {
+			// Fill in the IP address of the interface we are listening on.
+			if (!localFound) { continue; }
+			ipv4 = localIpv4;
+			ipv6 = &localIpv6;
+		}
+		
+		if (ipv6->length() > 39) {
+			std::cerr << "Got wrong ipv6 string length: " << ipv6->length() << std::endl;
+			continue;
+		}
+		
+		servicesBody += "S";
+		ipv4 = bb.toGlobal(ipv4, he);
+		servicesBody += std::string((char*) &ipv4, 4);
+		uint8_t ipv6len = ipv6->length();
+		servicesBody += (char) ipv6len;
+		servicesBody += *ipv6;
+		
+		uint16_t hlen = services[i].hostname.length();
+		hlen = bb.toGlobal(hlen, he);
+		servicesBody += std::string((char*) &hlen, 2);
+		servicesBody += services[i].hostname;
+		
+		uint16_t port = bb.toGlobal(services[i].port, he);
+		servicesBody += std::string((char*) &port, 2);
+		servicesBody += (char) (services[i].protocol);
+		
+		uint16_t snlen = services[i].service.length();
+		snlen = bb.toGlobal(snlen, he);
+		servicesBody += std::string((char*) &snlen, 2);
+		servicesBody += services[i].service;
+		
+		scount++;
+	}
+	
+	servicesMutex.unlock();
+	
 #ifdef DEBUG
-				std::cout << "Found IP: " << ip << std::endl;
+	std::cout <<"Services body generated of size: " << servicesBody.length() << std::endl;
 #endif
-				if (!isIPv6) {
-					// Find first IPv4 address on this network interface.
-					for (int j = 0; j < count; ++j) {
-						if (it->second.address(j).af() == AF_INET) {
-							ipv4 = NyanSD::ipv4_stringToUint(it->second.address(j).toString());
-							return true;
-						}
-					}
+	
+	// Assemble the full response message.
+	std::string msg = "NYANSD";
+	uint16_t msglen = 1;
+	uint8_t type = (uint8_t) NYSD_MESSAGE_TYPE_RESPONSE;
+
+	msglen += servicesBody.length() + 1;	// Add 1 for service section counter.
+	msglen = bb.toGlobal(msglen, he);
+	msg += std::string((char*) &msglen, 2);
+	msg += (char) type;
+	msg += std::string((char*) &scount, 1);
+	msg += servicesBody;
+	
+	return msg;
+}
+
+
+// --- GET RESPONSE ---
+// Look up the response message for a query from the sender, building it if it isn't cached yet.
+// Cached responses are keyed by filter and sender address, so that a cached response is found 
+// without going through the interface table. They are rebuilt after a service was added or the 
+// interface table was refreshed, and after a while to pick up interface changes.
+const std::string& NyanSD::getResponse(std::string_view filter, Poco::Net::SocketAddress &sender) {
+	std::string key(filter);
+	key += '\n';
+	key += sender.host().toString();
+	
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::map<std::string, NYSD_response>::iterator it = responseCache.find(key);
+	if (it != responseCache.end() && it->second.generation == servicesGeneration && 
+									now - it->second.created < std::chrono::seconds(30)) {
+		return it->second.msg;
+	}
+	
+	uint32_t localIpv4 = 0;
+	std::string localIpv6;
+	bool localFound = remoteToLocalIP(sender, localIpv4, localIpv6);
+	if (!localFound) {
+		std::cerr << "Failed to convert remote IP to local." << std::endl;
+	}
+	
+	// Read the generation after the lookup, which may have refreshed the interface table.
+	uint32_t generation = servicesGeneration;
+	
+	// Don't let arbitrary filters and senders grow the cache without bounds.
+	if (it == responseCache.end() && responseCache.size() >= 256) { responseCache.clear(); }
+	
+	NYSD_response& rs = responseCache[key];
+	rs.msg = buildResponse(filter, localFound, localIpv4, localIpv6);
+	rs.generation = generation;
+	rs.created = now;
+	
+	return rs.msg;
+}
+
+
+// --- ACCEPT QUERY ---
+// Check whether a query message should be answered. A query which is identical to one received
+// from the same sender within the deduplication window is dropped, as is a query from a host
+// which has run out of tokens in its token bucket. Only used by the client handler thread.
+bool NyanSD::acceptQuery(Poco::Net::SocketAddress &sender, const char* data, uint32_t n) {
+	stats.queries++;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	
+	// The limits may be changed by setQueryLimits() while the listener runs.
+	uint32_t window = dedupWindow;
+	double rate = rateLimit;
+	uint32_t burst = rateBurst;
+	
+	// Deduplication, keyed by sender address and port, and the query sections. Responses go to
+	// the sending socket, so identical queries from other sockets on the host are answered.
+	if (window > 0) {
+		std::string key = sender.toString();
+		key += '\n';
+		key.append(data, n);
+		
+		std::map<std::string, std::chrono::steady_clock::time_point>::iterator it;
+		it = recentQueries.find(key);
+		if (it != recentQueries.end() && 
+						now - it->second < std::chrono::milliseconds(window)) {
+			stats.duplicates++;
+			return false;
+		}
+		
+		// Drop expired entries before the map grows large.
+		if (recentQueries.size() >= 1024) {
+			it = recentQueries.begin();
+			while (it != recentQueries.end()) {
+				if (now - it->second >= std::chrono::milliseconds(window)) {
+					it = recentQueries.erase(it);
 				}
-				else {
-					// Find first IPv6 address on this network interface.
-					for (int j = 0; j < count; ++j) {
-						if (it->second.address(j).af() == AF_INET6) {
-							ipv6 = it->second.address(j).toString();
-							
-							// Remove trailing '%<if>' section on certain OSes.
-							std::string::size_type st = ipv6.find_last_of('%');
-							if (st != std::string::npos) { ipv6.erase(st); }
-					
-							return true;
-						}
+				else { ++it; }
+			}
+			
+			if (recentQueries.size() >= 1024) { recentQueries.clear(); }
+		}
+		
+		recentQueries[key] = now;
+	}
+	
+	// Token bucket per sending host.
+	if (rate > 0.0) {
+		std::string host = sender.host().toString();
+		std::map<std::string, NYSD_bucket>::iterator it = buckets.find(host);
+		if (it == buckets.end()) {
+			// Drop buckets which have refilled completely, as they're equal to new ones.
+			if (buckets.size() >= 1024) {
+				it = buckets.begin();
+				while (it != buckets.end()) {
+					double elapsed = std::chrono::duration<double>(now - it->second.updated).count();
+					if (it->second.tokens + (elapsed * rate) >= burst) {
+						it = buckets.erase(it);
 					}
+					else { ++it; }
 				}
 				
-				return false;
+				if (buckets.size() >= 1024) { buckets.clear(); }
 			}
+			
+			it = buckets.insert(std::make_pair(host, NYSD_bucket())).first;
+			it->second.tokens = burst;
+			it->second.updated = now;
 		}
+		
+		NYSD_bucket& bucket = it->second;
+		double elapsed = std::chrono::duration<double>(now - bucket.updated).count();
+		bucket.tokens += elapsed * rate;
+		if (bucket.tokens > burst) { bucket.tokens = burst; }
+		bucket.updated = now;
+		if (bucket.tokens < 1.0) {
+			stats.rateLimited++;
+			return false;
+		}
+		
+		bucket.tokens -= 1.0;
 	}
 	
-#ifdef DEBUG
-	std::cout << "LAN IP not found on interfaces." << std::endl;
-#endif
+	stats.answered++;
 	
-	return false;
+	return true;
+}
+
+
+// --- SET QUERY LIMITS ---
+// Set the deduplication window in milliseconds, and the sustained rate and burst size of the 
+// per-host token bucket. A window or rate of 0 disables the respective check. Can be changed 
+// while the listener is running.
+void NyanSD::setQueryLimits(uint32_t window, double rate, uint32_t burst) {
+	dedupWindow = window;
+	rateLimit = rate;
+	rateBurst = (burst > 0) ? burst : 1;
+}
+
+
+// --- GET LISTENER STATS ---
+// Obtain the counters for queries received and suppressed by the listener.
+NYSD_listener_stats NyanSD::getListenerStats() {
+	NYSD_listener_stats out;
+	out.queries = stats.queries;
+	out.answered = stats.answered;
+	out.duplicates = stats.duplicates;
+	out.rateLimited = stats.rateLimited;
+	
+	return out;
 }
 
 
 // --- CLIENT HANDLER ---
-void NyanSD::clientHandler(uint16_t port) {
+void NyanSD::clientHandler(uint16_t port, bool multicast) {
 	// Set up listening socket on the provided port.
-	Poco::Net::DatagramSocket udpsocket;
+	Poco::Net::Socket::SocketList sockets;
+	Poco::Net::MulticastSocket udpsocket;
 	Poco::Net::SocketAddress sa(Poco::Net::IPAddress(), port);
 	udpsocket.bind(sa, true);
+	sockets.push_back(udpsocket);
+	
+	// Join the multicast groups. The IPv4 group is received on the socket bound above.
+	if (multicast) {
+		joinGroup(udpsocket, Poco::Net::IPAddress(NYSD_MULTICAST_IPV4));
+		
+		// The IPv6 socket is IPv6-only, as IPv4 queries would otherwise be received and answered
+		// on both sockets.
+		try {
+			Poco::Net::MulticastSocket udp6(Poco::Net::IPAddress::IPv6);
+			udp6.impl()->bind6(Poco::Net::SocketAddress(Poco::Net::IPAddress(
+										Poco::Net::IPAddress::IPv6), port), true, true, true);
+			if (joinGroup(udp6, Poco::Net::IPAddress(NYSD_MULTICAST_IPV6))) {
+				sockets.push_back(udp6);
+			}
+		}
+		catch (Poco::Exception &e) {
+			std::cerr << "Failed to set up IPv6 multicast listener: " << e.displayText() << std::endl;
+		}
+	}
+	
+	// The wakeup socket only serves to interrupt the select() call below when stopping, so the 
+	// timeout can be long.
+	sockets.push_back(*wakeupSocket);
+	
+	// Filters of the query being answered. They point into the receive buffer.
+	std::vector<std::string_view> filters;
 	
 	// Start listening loop.
-	running = true;
 	while (running) {
-		// Read data in from socket.
+		// Read data in from the sockets.
 		Poco::Net::SocketAddress sender;
-		Poco::Timespan span(250000);
-		if (udpsocket.poll(span, Poco::Net::Socket::SELECT_READ)) {
+		Poco::Timespan span(60, 0);
+		Poco::Net::Socket::SocketList readList(sockets), writeList, exceptList;
+		if (Poco::Net::Socket::select(readList, writeList, exceptList, span) == 0) { continue; }
+		for (uint32_t r = 0; r < readList.size() && running; ++r) {
+			Poco::Net::DatagramSocket udpsocket(readList[r]);
+			if (readList[r] == *wakeupSocket) {
+				char c;
+				try { udpsocket.receiveBytes(&c, 1); }
+				catch (Poco::Exception &exc) { }
+				continue;
+			}
+			
 			char buffer[2048];
 			int n = 0;
 			try {
@@ -537,8 +1044,8 @@ void NyanSD::clientHandler(uint16_t port) {
 			}
 			
 			// Parse message for queries.
-			BBEndianness he = bb.getHostEndian();
-			uint8_t rnum = *((char*) &buffer[index++]);
+			int body = index;
+			uint8_t rnum = (uint8_t) buffer[index++];
 #ifdef DEBUG
 			std::cout << "Query count: " << (uint16_t) rnum << std::endl;
 #endif
@@ -548,155 +1055,44 @@ void NyanSD::clientHandler(uint16_t port) {
 				continue;
 			}
 		
-			// Query sections.
+			// Query sections. The whole message is validated before it is checked against the 
+			// query limits, so that malformed messages don't use up a host's tokens.
+			NYSD_reader rd(buffer + index, n - index);
+			filters.clear();
 			for (int i = 0; i < rnum; ++i) {
-				if (buffer[index] != 'Q') {
-					std::cerr << "Invalid query section signature: " << std::showbase << std::hex 
-								<< (uint16_t) buffer[index] << std::dec
-								<< ". Aborting parsing." << std::endl;
-					continue;
+				if (rd.u8() != 'Q') {
+					std::cerr << "Invalid query section signature. Aborting parsing." << std::endl;
+					break;
 				}
 				
-				index++;
-				uint8_t prot = *((uint8_t*) &buffer[index++]);				
-				uint8_t qlen = *((uint8_t*) &buffer[index++]);
-				
-				std::string servicesBody;
-				uint8_t scount = 0;
-				if (qlen != 0) {
-					std::string filter = std::string(&(buffer[index]), qlen);
-					index += qlen;
-					
-					// Create response body if request matches local data.
-					// The match is done using a simple substring compare on the beginning of the
-					// filter and service string.
-					servicesMutex.lock();
-					for (int i = 0; i < services.size(); ++i) {
-						if (filter.compare(0, filter.length(), services[i].service) == 0) {
-							servicesBody += "S";
-							if (services[i].ipv4 == 0) {
-								// Fill in the IP address of the interface we are listening on.
-								uint32_t ipv4;
-								std::string ipv6;
-								if (!remoteToLocalIP(sender, ipv4, ipv6)) {
-									std::cerr << "Failed to convert remote IP to local." << std::endl;
-									continue;
-								}
-								
-								if (ipv6.length() > 39) {
-									std::cerr << "Got wrong ipv6 string length: " << ipv6.length() 
-												<< std::endl;
-									continue;
-								}
-								
-								ipv4 = bb.toGlobal(ipv4, he);
-								servicesBody += std::string((char*) &ipv4, 4);
-								uint8_t ipv6len = ipv6.length();
-								servicesBody += (char) ipv6len;
-								servicesBody += ipv6;
-							}
-							else {
-								uint32_t ipv4 = bb.toGlobal(services[i].ipv4, he);
-								servicesBody += std::string((char*) &ipv4, 4);
-								uint8_t ipv6len = services[i].ipv6.length();
-								servicesBody += (char) ipv6len;
-								servicesBody += services[i].ipv6;
-							}
-							
-							uint16_t hlen = services[i].hostname.length();
-							hlen = bb.toGlobal(hlen, he);
-							servicesBody += std::string((char*) &hlen, 2);
-							servicesBody += services[i].hostname;
-							
-							uint16_t port = bb.toGlobal(services[i].port, he);
-							servicesBody += std::string((char*) &port, 2);
-							servicesBody += (char) (services[i].protocol);
-							
-							uint16_t snlen = services[i].service.length();
-							snlen = bb.toGlobal(snlen, he);
-							servicesBody += std::string((char*) &snlen, 2);
-							servicesBody += services[i].service;
-							
-							scount++;
-						}
-					}
-					servicesMutex.unlock();
+				uint8_t prot = rd.u8();
+				uint8_t qlen = rd.u8();
+				std::string_view filter = rd.bytes(qlen);
+				if (!rd.ok) {
+					std::cerr << "Truncated query section. Aborting parsing." << std::endl;
+					break;
 				}
-				else {
-					// Create response body containing all local data.
-					servicesMutex.lock();
-					for (int i = 0; i < services.size(); ++i) {
-						servicesBody += "S";
-						if (services[i].ipv4 == 0) {
-							// Fill in the IP address of the interface we are listening on.
-							uint32_t ipv4;
-							std::string ipv6;
-							if (!remoteToLocalIP(sender, ipv4, ipv6)) {
-								std::cerr << "Failed to convert remote IP to local." << std::endl;
-								continue;
-							}
-							
-							if (ipv6.length() > 39) {
-								std::cerr << "Got wrong ipv6 string length: " << ipv6.length() 
-											<< std::endl;
-								continue;
-							}
-							
-							ipv4 = bb.toGlobal(ipv4, he);
-							servicesBody += std::string((char*) &ipv4, 4);
-							uint8_t ipv6len = ipv6.length();
-							servicesBody += (char) ipv6len;
-							servicesBody += ipv6;
-						}
-						else {
-							uint32_t ipv4 = bb.toGlobal(services[i].ipv4, he);
-							servicesBody += std::string((char*) &ipv4, 4);
-							uint8_t ipv6len = services[i].ipv6.length();
-							servicesBody += (char) ipv6len;
-							servicesBody += services[i].ipv6;
-						}
-						
-						uint16_t hlen = services[i].hostname.length();
-						hlen = bb.toGlobal(hlen, he);
-						servicesBody += std::string((char*) &hlen, 2);
-						servicesBody += services[i].hostname;
-							
-						uint16_t port = bb.toGlobal(services[i].port, he);
-						servicesBody += std::string((char*) &port, 2);
-						servicesBody += (char) (services[i].protocol);
-						
-						uint16_t snlen = services[i].service.length();
-						snlen = bb.toGlobal(snlen, he);
-						servicesBody += std::string((char*) &snlen, 2);
-						servicesBody += services[i].service;
-						
-						scount++;
-					}
-					
-					servicesMutex.unlock();
-				}
-				
-#ifdef DEBUG
-				std::cout <<"Services body generated of size: " << servicesBody.length() << std::endl;
-#endif
 				
-				// Assemble the full response message.
-				std::string msg = "NYANSD";
-				uint16_t msglen = 1;
-				uint8_t type = (uint8_t) NYSD_MESSAGE_TYPE_RESPONSE;
-
-				msglen += servicesBody.length() + 1;	// Add 1 for service section counter.
-				msglen = bb.toGlobal(msglen, he);
-				msg += std::string((char*) &msglen, 2);
-				msg += (char) type;
-				msg += std::string((char*) &scount, 1);
-				msg += servicesBody;
+				filters.push_back(filter);
+			}
+			
+			if (filters.size() != rnum) { continue; }
+			if (!acceptQuery(sender, buffer + body, n - body)) { continue; }
+			
+			// Each query is answered with its cached response message.
+			for (uint32_t i = 0; i < filters.size(); ++i) {
+				const std::string& msg = getResponse(filters[i], sender);
 				
 #ifdef DEBUG
 				std::cout << "Sending response with size: " << msg.length() << std::endl;
 #endif
 				
-				int n = udpsocket.sendTo(msg.data(), msg.length(), sender);
+				try {
+					udpsocket.sendTo(msg.data(), msg.length(), sender);
+				}
+				catch (Poco::Exception &exc) {
+					std::cerr << "SendTo: " << exc.displayText() << std::endl;
+				}
 			}
 		}
 	}
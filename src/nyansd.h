@@ -17,8 +17,23 @@
 #include <thread>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <functional>
+#include <map>
+#include <chrono>
+#include <memory>
 
 #include "bytebauble.h"
+#include "nyansd_ifwatch.h"
+
+#include <Poco/Net/Socket.h>
+#include <Poco/Net/DatagramSocket.h>
+#include <Poco/Net/SocketAddress.h>
+
+
+// Multicast groups for NyanSD queries.
+const char* const NYSD_MULTICAST_IPV4 = "239.255.78.83";
+const char* const NYSD_MULTICAST_IPV6 = "ff02::4e53";
 
 
 enum NYSD_message_type {
@@ -47,24 +62,107 @@ struct NYSD_service {
 struct NYSD_query {
 	NYSD_protocol protocol;
 	std::string filter;
+	uint16_t port = 0;		// Only send the query to this port. 0 for all ports.
+};
+
+
+// Address of a local network interface, with its subnet.
+struct NYSD_interface {
+	unsigned index = 0;
+	Poco::Net::IPAddress address;
+	Poco::Net::IPAddress mask;
+	Poco::Net::IPAddress broadcast;	// IPv4 only.
 };
 
 
+// Query counters of the listener.
+struct NYSD_listener_stats {
+	uint64_t queries = 0;		// Valid query messages received.
+	uint64_t answered = 0;
+	uint64_t duplicates = 0;	// Dropped as duplicate within the deduplication window.
+	uint64_t rateLimited = 0;	// Dropped by the per-host rate limit.
+};
+
+
+// Token bucket for rate limiting queries from a host.
+struct NYSD_bucket {
+	double tokens = 0.0;
+	std::chrono::steady_clock::time_point updated;
+};
+
+
+// Pre-encoded response message, as cached by the listener.
+struct NYSD_response {
+	std::string msg;
+	uint32_t generation = 0;
+	std::chrono::steady_clock::time_point created;
+};
+
+
+// Called for each service found by a streaming query. Return false to end the query. The 
+// service is only valid for the duration of the call and should be copied to be kept.
+typedef std::function<bool(NYSD_service &service)> NYSD_callback;
+
+
 class NyanSD {
 	static std::vector<NYSD_service> services;
 	static std::mutex servicesMutex;
+	static std::atomic<uint32_t> servicesGeneration;
+	static std::map<std::string, NYSD_response> responseCache;
+	static std::vector<NYSD_interface> interfaces;
+	static std::mutex interfacesMutex;
+	static std::chrono::steady_clock::time_point interfacesUpdated;
+	static bool interfacesValid;
+	static NYSD_ifwatch ifwatch;
 	static std::atomic<bool> running;
 	static std::thread handler;
+	static std::unique_ptr<Poco::Net::DatagramSocket> wakeupSocket;
+	
+	// Query deduplication and rate limiting.
+	struct ListenerCounters {
+		std::atomic<uint64_t> queries{0};
+		std::atomic<uint64_t> answered{0};
+		std::atomic<uint64_t> duplicates{0};
+		std::atomic<uint64_t> rateLimited{0};
+	};
+	
+	static std::map<std::string, std::chrono::steady_clock::time_point> recentQueries;
+	static std::map<std::string, NYSD_bucket> buckets;
+	static std::atomic<uint32_t> dedupWindow;
+	static std::atomic<double> rateLimit;
+	static std::atomic<uint32_t> rateBurst;
+	static ListenerCounters stats;
 	static ByteBauble bb;
 	
-	static void clientHandler(uint16_t port);
+	static void clientHandler(uint16_t port, bool multicast);
+	static void refreshInterfaces();
+	static void updateInterfaces();
+	static bool remoteToLocalIP(Poco::Net::SocketAddress &sa, uint32_t &ipv4, std::string &ipv6);
+	static bool acceptQuery(Poco::Net::SocketAddress &sender, const char* data, uint32_t n);
+	static std::string buildResponse(std::string_view filter, bool localFound, uint32_t localIpv4, 
+														const std::string &localIpv6);
+	static const std::string& getResponse(std::string_view filter, Poco::Net::SocketAddress &sender);
+	static std::string buildQuery(std::vector<NYSD_query> &queries, uint16_t port);
+	static void broadcastQuery(std::vector<std::string> &msgs, std::vector<uint16_t> &ports, 
+											Poco::Net::Socket::SocketList &sockets);
+	static void multicastQuery(std::vector<std::string> &msgs, std::vector<uint16_t> &ports, 
+											Poco::Net::Socket::SocketList &sockets);
 	
 public:
 	static bool sendQuery(uint16_t port, std::vector<NYSD_query> queries, 
-										std::vector<NYSD_service> &responses);
+										std::vector<NYSD_service> &responses, 
+										bool multicast = false);
+	static bool sendQuery(uint16_t port, std::vector<NYSD_query> queries, NYSD_callback callback,
+										bool multicast = false);
+	static bool sendQuery(std::vector<uint16_t> ports, std::vector<NYSD_query> queries, 
+										NYSD_callback callback, bool multicast = false);
 	static bool addService(NYSD_service service);
-	static bool startListener(uint16_t port);
+	static bool startListener(uint16_t port, bool multicast = false);
 	static bool stopListener();
+	static std::vector<NYSD_interface> getInterfaces();
+	static void setQueryLimits(uint32_t window, double rate, uint32_t burst);
+	static NYSD_listener_stats getListenerStats();
+	static bool parseResponse(const char* buffer, uint32_t n, NYSD_callback &callback, bool &stop);
 	
 	static std::string ipv4_uintToString(uint32_t ipv4);
 	static uint32_t ipv4_stringToUint(std::string ipv4);
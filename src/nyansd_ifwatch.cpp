@@ -0,0 +1,97 @@
+/*
+	nyansd_ifwatch.cpp - Network interface change notifications for NyanSD.
+	
+	Notes:
+			- Not thread-safe. NyanSD only uses it with its interfaces mutex held.
+*/
+
+
+#include "nyansd_ifwatch.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <unistd.h>
+#endif
+
+
+NYSD_ifwatch::~NYSD_ifwatch() {
+	close();
+}
+
+
+// --- OPEN ---
+// Open the notification socket. Returns false if this isn't supported or failed before.
+bool NYSD_ifwatch::open() {
+	if (failed) { return false; }
+	
+#ifdef __linux__
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (fd < 0) {
+		std::cerr << "Failed to open netlink socket. Using TTL for interface changes." << std::endl;
+		fd = -1;
+		failed = true;
+		return false;
+	}
+	
+	struct sockaddr_nl addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+	if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+		std::cerr << "Failed to bind netlink socket. Using TTL for interface changes." << std::endl;
+		::close(fd);
+		fd = -1;
+		failed = true;
+		return false;
+	}
+	
+	return true;
+#else
+	failed = true;
+	return false;
+#endif
+}
+
+
+// --- CHANGED ---
+// Check for address or link change notifications. The first call after opening or closing the 
+// watch returns true, as changes in the meantime were missed.
+bool NYSD_ifwatch::changed() {
+	if (fd < 0) { return open(); }
+	
+#ifdef __linux__
+	// Empty the socket. Any notification means the table has to be refreshed. ENOBUFS means
+	// that notifications were dropped as the socket buffer overflowed, which counts as a change 
+	// as well. The socket remains usable, so keep draining it.
+	bool changed = false;
+	char buffer[4096];
+	while (true) {
+		ssize_t n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+		if (n > 0) { changed = true; }
+		else if (n < 0 && errno == ENOBUFS) { changed = true; }
+		else if (n < 0 && errno == EINTR) { continue; }
+		else { break; }
+	}
+	
+	return changed;
+#else
+	return false;
+#endif
+}
+
+
+// --- CLOSE ---
+// Close the notification socket. It is opened again on the next call to changed().
+void NYSD_ifwatch::close() {
+#ifdef __linux__
+	if (fd >= 0) { ::close(fd); }
+#endif
+	
+	fd = -1;
+}
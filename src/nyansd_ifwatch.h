@@ -0,0 +1,28 @@
+/*
+	nyansd_ifwatch.h - Network interface change notifications for NyanSD.
+	
+	Notes:
+			- Uses a netlink socket on Linux. On other platforms no changes are reported, and the
+			  NyanSD interface table is only refreshed after its TTL expires.
+*/
+
+
+#ifndef NYANSD_IFWATCH_H
+#define NYANSD_IFWATCH_H
+
+
+class NYSD_ifwatch {
+	int fd = -1;
+	bool failed = false;
+	
+	bool open();
+	
+public:
+	~NYSD_ifwatch();
+	
+	bool changed();
+	void close();
+};
+
+
+#endif
@@ -14,6 +14,8 @@
 
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <random>
 
 #ifdef _WIN32
 #include <filesystem> 		// C++17
@@ -163,101 +165,202 @@ void NymphCastClient::MediaSeekCallback(uint32_t session, NymphMessage* msg, voi
 }
 
 
+// Decoding table for the playback status struct sent by the remote.
+static const struct {
+	const char* name;
+	NymphStatusField field;
+} statusFields[] = {
+	{ "playing", 			NYMPH_STATUS_FIELD_PLAYING },
+	{ "status", 			NYMPH_STATUS_FIELD_STATUS },
+	{ "duration", 			NYMPH_STATUS_FIELD_DURATION },
+	{ "position", 			NYMPH_STATUS_FIELD_POSITION },
+	{ "volume", 			NYMPH_STATUS_FIELD_VOLUME },
+	{ "artist", 			NYMPH_STATUS_FIELD_ARTIST },
+	{ "title", 				NYMPH_STATUS_FIELD_TITLE },
+	{ "stopped", 			NYMPH_STATUS_FIELD_STOPPED },
+	{ "subtitle_disable", 	NYMPH_STATUS_FIELD_SUBTITLES }
+};
+
+
+// --- DECODE STATUS ---
+// Decode the playback status struct into the provided status object. On failure the name of
+// the missing field is returned in 'missing' and the status has its error flag set.
+bool NymphCastClient::decodeStatus(NymphType* nstruct, NymphPlaybackStatus &stat, 
+																	std::string &missing) {
+	stat.error = true;
+	const uint32_t count = sizeof(statusFields) / sizeof(statusFields[0]);
+	for (uint32_t i = 0; i < count; ++i) {
+		NymphType* value;
+		if (!nstruct->getStructValue(statusFields[i].name, value)) {
+			missing = statusFields[i].name;
+			return false;
+		}
+		
+		switch (statusFields[i].field) {
+			case NYMPH_STATUS_FIELD_PLAYING: stat.playing = value->getBool(); break;
+			case NYMPH_STATUS_FIELD_STATUS: 
+				stat.status = (NymphRemoteStatus) value->getUint32(); 
+				break;
+			case NYMPH_STATUS_FIELD_DURATION: stat.duration = value->getUint64(); break;
+			case NYMPH_STATUS_FIELD_POSITION: stat.position = value->getDouble(); break;
+			case NYMPH_STATUS_FIELD_VOLUME: stat.volume = value->getUint8(); break;
+			case NYMPH_STATUS_FIELD_ARTIST: stat.artist = value->getString(); break;
+			case NYMPH_STATUS_FIELD_TITLE: stat.title = value->getString(); break;
+			case NYMPH_STATUS_FIELD_STOPPED: stat.stopped = value->getBool(); break;
+			case NYMPH_STATUS_FIELD_SUBTITLES: stat.subtitles_off = value->getBool(); break;
+			default: break;
+		}
+	}
+	
+	stat.error = false;
+	
+	return true;
+}
+
+
 // --- MEDIA STATUS CALLBACK ---
 // Gets called every time the active remote media changes status.
 void NymphCastClient::MediaStatusCallback(uint32_t session, NymphMessage* msg, void* data) {
 	// Send received data to registered callback.
-	NymphPlaybackStatus stat;
-	stat.error = true;
-	
-	NymphType* nstruct = msg->parameters()[0];
-	NymphType* splay;
-	if (!nstruct->getStructValue("playing", splay)) {
-		//std::cerr << "MediaStatusCallback: Failed to find value 'playing' in struct." << std::endl;
-		NYMPH_LOG_ERROR("MediaStatusCallback: Failed to find value 'playing' in struct.");
+	// The status object is reused between calls for this thread.
+	static thread_local NymphPlaybackStatus stat;
+	std::string missing;
+	if (!decodeStatus(msg->parameters()[0], stat, missing)) {
+		NYMPH_LOG_ERROR("MediaStatusCallback: Failed to find value '" + missing + "' in struct.");
 		msg->discard();
 		return;
 	}
 	
-	stat.error = false;
-	stat.playing = splay->getBool();
-	NymphType* status;
-	NymphType* duration;
-	NymphType* position;
-	NymphType* volume;
-	NymphType* artist;
-	NymphType* title;
-	NymphType* stopped;
-	NymphType* subdis;
-	if (!nstruct->getStructValue("status", status)) {
-		//std::cerr << "MediaStatusCallback: Failed to find value 'status' in struct." << std::endl;
-		NYMPH_LOG_ERROR("MediaStatusCallback: Failed to find value 'status' in struct.");
-		msg->discard();
-		return;
-	}
+	msg->discard();
 	
-	if (!nstruct->getStructValue("duration", duration)) {
-		//std::cerr << "MediaStatusCallback: Failed to find value 'duration' in struct." << std::endl;
-		NYMPH_LOG_ERROR("MediaStatusCallback: Failed to find value 'duration' in struct.");
-		msg->discard();
-		return;
+	uint32_t handle = userHandle(session);
+	uint32_t changed = updateStatusCache(handle, stat);
+	if (!throttleStatus(handle, changed)) { return; }
+	
+	deliverStatus(handle, changed, stat);
+}
+
+
+// --- DELIVER STATUS ---
+// Pass a status update on to the user callbacks.
+void NymphCastClient::deliverStatus(uint32_t handle, uint32_t changed, NymphPlaybackStatus &stat) {
+	if (statusDeltaFunction && changed != 0) {
+		statusDeltaFunction(handle, changed, stat);
 	}
 	
-	if (!nstruct->getStructValue("position", position)) {
-		//std::cerr << "MediaStatusCallback: Failed to find value 'position' in struct." << std::endl;
-		NYMPH_LOG_ERROR("MediaStatusCallback: Failed to find value 'position' in struct.");
-		msg->discard();
-		return;
+	if (statusUpdateFunction) {
+		statusUpdateFunction(handle, stat);
+	}
+}
+
+
+// --- THROTTLE STATUS ---
+// Apply the status subscription of the handle, if any, to a status update. Returns true if the 
+// update should be delivered now, with 'changed' set to the fields changed since the last 
+// delivered update. Otherwise the update is dropped, or delivered later by flushStatus() if it 
+// arrived within the subscription interval.
+bool NymphCastClient::throttleStatus(uint32_t handle, uint32_t &changed) {
+	subscriptionsMutex.lock();
+	std::map<uint32_t, StatusSubscription>::iterator it = subscriptions.find(handle);
+	if (it == subscriptions.end()) {
+		subscriptionsMutex.unlock();
+		return true;
 	}
 	
-	if (!nstruct->getStructValue("volume", volume)) {
-		//std::cerr << "MediaStatusCallback: Failed to find value 'volume' in struct." << std::endl;
-		NYMPH_LOG_ERROR("MediaStatusCallback: Failed to find value 'volume' in struct.");
-		msg->discard();
-		return;
+	StatusSubscription& sub = it->second;
+	sub.changed |= changed & sub.fields;
+	if (sub.changed == 0) {
+		subscriptionsMutex.unlock();
+		return false;
 	}
 	
-	if (!nstruct->getStructValue("artist", artist)) {
-		//std::cerr << "MediaStatusCallback: Failed to find value 'artist' in struct." << std::endl;
-		NYMPH_LOG_ERROR("MediaStatusCallback: Failed to find value 'artist' in struct.");
-		msg->discard();
-		return;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point due = sub.lastDelivered + 
+													std::chrono::milliseconds(sub.interval);
+	if (now >= due) {
+		changed = sub.changed;
+		sub.changed = 0;
+		sub.lastDelivered = now;
+		subscriptionsMutex.unlock();
+		return true;
 	}
 	
-	if (!nstruct->getStructValue("title", title)) {
-		//std::cerr << "MediaStatusCallback: Failed to find value 'title' in struct." << std::endl;
-		NYMPH_LOG_ERROR("MediaStatusCallback: Failed to find value 'title' in struct.");
-		msg->discard();
-		return;
+	// Deliver the latest status once the interval has passed.
+	if (!sub.flushScheduled) {
+		sub.flushScheduled = true;
+		uint32_t delay = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count();
+		scheduleTask(delay + 1, std::bind(&NymphCastClient::flushStatus, this, handle));
 	}
 	
-	if (!nstruct->getStructValue("stopped", stopped)) {
-		//std::cerr << "MediaStatusCallback: Failed to find value 'stopped' in struct." << std::endl;
-		NYMPH_LOG_ERROR("MediaStatusCallback: Failed to find value 'stopped' in struct.");
-		msg->discard();
+	subscriptionsMutex.unlock();
+	
+	return false;
+}
+
+
+// --- FLUSH STATUS ---
+// Deliver the status update held back by the subscription of the handle.
+void NymphCastClient::flushStatus(uint32_t handle) {
+	subscriptionsMutex.lock();
+	std::map<uint32_t, StatusSubscription>::iterator it = subscriptions.find(handle);
+	if (it == subscriptions.end() || it->second.changed == 0) {
+		if (it != subscriptions.end()) { it->second.flushScheduled = false; }
+		subscriptionsMutex.unlock();
 		return;
 	}
 	
-	if (!nstruct->getStructValue("subtitle_disable", subdis)) {
-		//std::cerr << "MediaStatusCallback: Failed to find value 'subtitle_disable' in struct." << std::endl;
-		NYMPH_LOG_ERROR("MediaStatusCallback: Failed to find value 'subtitle_disable' in struct.");
+	uint32_t changed = it->second.changed;
+	it->second.changed = 0;
+	it->second.flushScheduled = false;
+	it->second.lastDelivered = std::chrono::steady_clock::now();
+	subscriptionsMutex.unlock();
+	
+	statusMutex.lock();
+	std::map<uint32_t, CachedStatus>::const_iterator sit = statusCache.find(handle);
+	if (sit == statusCache.end()) {
+		statusMutex.unlock();
 		return;
 	}
 	
-	stat.status = (NymphRemoteStatus) status->getUint32();
-	stat.duration = duration->getUint64();
-	stat.position = position->getDouble();
-	stat.volume = volume->getUint8();
-	stat.artist = artist->getString();
-	stat.title = title->getString();
-	stat.stopped = stopped->getBool();
-	stat.subtitles_off = subdis->getBool();
+	NymphPlaybackStatus stat = sit->second.status;
+	statusMutex.unlock();
 	
-	if (statusUpdateFunction) {
-		statusUpdateFunction(session, stat);
-	}
+	dispatchEvent([this, handle, changed, stat]() mutable { 
+		deliverStatus(handle, changed, stat); 
+	});
+}
+
+
+// --- SUBSCRIBE STATUS ---
+/**
+	Limit the status updates passed to the status update and delta callbacks for a remote. 
+	Updates arriving faster than the maximum rate are coalesced, with the latest status being
+	delivered once the interval has passed. Updates which only change fields outside of the
+	provided field mask are dropped.
 	
-	msg->discard();
+	@param handle 	The handle for the remote server.
+	@param maxRate	Maximum number of updates per second. 0 for no limit.
+	@param fields	Bitmask of NymphStatusField values to receive updates for.
+*/
+void NymphCastClient::subscribeStatus(uint32_t handle, double maxRate, uint32_t fields) {
+	subscriptionsMutex.lock();
+	StatusSubscription& sub = subscriptions[handle];
+	sub.interval = (maxRate > 0.0) ? (uint32_t) (1000.0 / maxRate) : 0;
+	sub.fields = fields;
+	subscriptionsMutex.unlock();
+}
+
+
+// --- UNSUBSCRIBE STATUS ---
+/**
+	Remove the status update limits set for a remote using subscribeStatus().
+	
+	@param handle 	The handle for the remote server.
+*/
+void NymphCastClient::unsubscribeStatus(uint32_t handle) {
+	subscriptionsMutex.lock();
+	subscriptions.erase(handle);
+	subscriptionsMutex.unlock();
 }
 
 
@@ -276,39 +379,531 @@ void NymphCastClient::ReceiveFromAppCallback(uint32_t session, NymphMessage* msg
 void NymphCastClient::DisconnectedCallback(uint32_t session) {
 	// Call the user-registered callback if available.
 	NYMPH_LOG_DEBUG("Remote disconnected callback function called.");
+	
+	// Pooled media server connections are internal. Mark them as dead so that they are dropped
+	// on the next checkout. A connection which was already closed by the pool is forgotten.
+	msPoolMutex.lock();
+	std::map<uint32_t, bool>::iterator mit = msHandles.find(session);
+	if (mit != msHandles.end()) {
+		if (msClosed.erase(session) > 0) { msHandles.erase(mit); }
+		else { mit->second = false; }
+		
+		msPoolMutex.unlock();
+		return;
+	}
+	
+	msPoolMutex.unlock();
+	
+	// Connections which were closed by the client itself have been handled already.
+	managedMutex.lock();
+	bool dropped = droppedPhysical.erase(session) > 0;
+	managedMutex.unlock();
+	if (dropped) { return; }
+	
+	// Managed connections are reconnected instead of reported.
+	if (startReconnect(session)) { return; }
+	
 	if (disconnectedFunction) {
 		disconnectedFunction(session);
 	}
 }
 
 
+// Set on task pool threads, to avoid waiting on a saturated pool from within the pool.
+static thread_local bool isTaskThread = false;
+
+
+// --- RUN TASK ---
+// Queue a task for execution on the background task pool. A new worker thread is started if not
+// enough workers are idle and the pool has not reached its maximum size yet. Returns false 
+// without queueing the task once the client is shutting down.
+bool NymphCastClient::runTask(std::function<void()> task) {
+	tasksMutex.lock();
+	if (!tasksRunning) {
+		tasksMutex.unlock();
+		return false;
+	}
+	
+	tasks.push_back(task);
+	if (tasksIdle < tasks.size() && taskThreads.size() < tasksMax) {
+		taskThreads.push_back(std::thread(&NymphCastClient::taskWorker, this));
+	}
+	
+	tasksMutex.unlock();
+	tasksCv.notify_one();
+	
+	return true;
+}
+
+
+// --- TASK AVAILABLE ---
+// Check whether a new task would start right away instead of being queued.
+bool NymphCastClient::taskAvailable() {
+	tasksMutex.lock();
+	bool available = tasksIdle > tasks.size() || taskThreads.size() < tasksMax;
+	tasksMutex.unlock();
+	
+	return available;
+}
+
+
+// --- TASK WORKER ---
+// Runs queued tasks until the client shuts down and the queue has been drained.
+void NymphCastClient::taskWorker() {
+	isTaskThread = true;
+	std::unique_lock<std::mutex> lock(tasksMutex);
+	while (true) {
+		if (tasks.empty()) {
+			if (!tasksRunning) { break; }
+			
+			tasksIdle++;
+			tasksCv.wait(lock, [this] { return !tasks.empty() || !tasksRunning; });
+			tasksIdle--;
+			continue;
+		}
+		
+		std::function<void()> task = tasks.front();
+		tasks.pop_front();
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
+
+
+// Set while the dispatch queue is being drained on this thread, i.e. during queued callbacks.
+static thread_local bool isDispatchThread = false;
+
+
+// --- DISPATCH EVENT ---
+// Run an event right away, queue it for process() when in event loop mode, or queue it for the
+// dispatcher thread or executor. Producers are counted while queueing, so that stopDispatch() 
+// can wait for those which saw the previous dispatch mode.
+void NymphCastClient::dispatchEvent(std::function<void()> event) {
+	if (eventLoop) {
+		postEvent(event);
+		return;
+	}
+	
+	dispatchProducers++;
+	uint32_t mode = dispatchMode;
+	if (mode != NYMPH_DISPATCH_DIRECT) {
+		queueEvent(event, mode);
+		dispatchProducers--;
+		return;
+	}
+	
+	dispatchProducers--;
+	event();
+}
+
+
+// --- DISPATCH CALLBACK ---
+// Wrap a NymphRPC callback so that it is invoked through dispatchEvent().
+NymphCallbackMethod NymphCastClient::dispatchCallback(NymphCallbackMethod callback) {
+	return [this, callback](uint32_t session, NymphMessage* msg, void* data) {
+		dispatchEvent(std::bind(callback, session, msg, data));
+	};
+}
+
+
+// Node in the dispatch queue. The queue always holds one node whose event has already been
+// taken, which is the node the consumer's tail points to.
+struct NymphCastClient::DispatchNode {
+	std::atomic<DispatchNode*> next{0};
+	std::function<void()> event;
+	std::chrono::steady_clock::time_point queued;
+};
+
+
+// --- QUEUE EVENT ---
+// Add an event to the dispatch queue. Producers only swap the head pointer, so this never 
+// blocks the network threads on a slow consumer.
+void NymphCastClient::queueEvent(std::function<void()> event, uint32_t mode) {
+	DispatchNode* node = new DispatchNode;
+	node->event = event;
+	node->queued = std::chrono::steady_clock::now();
+	
+	uint32_t depth = ++dispatchDepth;
+	uint32_t max = dispatchMaxDepth;
+	while (depth > max && !dispatchMaxDepth.compare_exchange_weak(max, depth)) { }
+	
+	DispatchNode* prev = dispatchHead.exchange(node, std::memory_order_acq_rel);
+	prev->next.store(node, std::memory_order_release);
+	
+	// Only the producer which finds the queue idle schedules a drain.
+	if (!dispatchScheduled.exchange(true)) { signalDispatch(mode); }
+}
+
+
+// --- SIGNAL DISPATCH ---
+// Start a drain of the dispatch queue on the dispatcher thread or the executor, as selected by 
+// the dispatch mode under which the event was queued.
+void NymphCastClient::signalDispatch(uint32_t mode) {
+	if (mode == NYMPH_DISPATCH_EXECUTOR) {
+		dispatchExecutor(std::bind(&NymphCastClient::drainDispatch, this));
+		return;
+	}
+	
+	dispatchMutex.lock();
+	dispatchSignal = true;
+	dispatchMutex.unlock();
+	dispatchCv.notify_one();
+}
+
+
+// --- DRAIN DISPATCH ---
+// Run all events in the dispatch queue, in order. Only one drain runs at any time.
+void NymphCastClient::drainDispatch() {
+	bool nested = isDispatchThread;
+	isDispatchThread = true;
+	do {
+		while (true) {
+			DispatchNode* next = dispatchTail->next.load(std::memory_order_acquire);
+			if (next == 0) {
+				// A producer may have swapped the head without linking its node yet.
+				if (dispatchHead.load(std::memory_order_acquire) == dispatchTail) { break; }
+				std::this_thread::yield();
+				continue;
+			}
+			
+			delete dispatchTail;
+			dispatchTail = next;
+			std::function<void()> event;
+			event.swap(next->event);
+			dispatchDepth--;
+			
+			uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(
+									std::chrono::steady_clock::now() - next->queued).count();
+			dispatchLatencyTotal += latency;
+			if (latency > dispatchLatencyMax) { dispatchLatencyMax = latency; }
+			dispatchCount++;
+			
+			event();
+		}
+		
+		dispatchScheduled = false;
+		
+		// Continue if an event was added after the queue was found empty and no other drain 
+		// has been scheduled for it.
+	} while (dispatchHead.load(std::memory_order_acquire) != dispatchTail && 
+														!dispatchScheduled.exchange(true));
+	
+	isDispatchThread = nested;
+}
+
+
+// --- DISPATCH LOOP ---
+// Dispatcher thread. Drains the dispatch queue each time it is signalled.
+void NymphCastClient::dispatchLoop() {
+	std::unique_lock<std::mutex> lock(dispatchMutex);
+	while (dispatchRunning || dispatchSignal) {
+		if (!dispatchSignal) {
+			dispatchCv.wait(lock);
+			continue;
+		}
+		
+		dispatchSignal = false;
+		lock.unlock();
+		drainDispatch();
+		lock.lock();
+	}
+}
+
+
+// --- STOP DISPATCH ---
+// Return to direct dispatching. Any queued events are run before this returns. Must not be 
+// called while draining the queue.
+void NymphCastClient::stopDispatch() {
+	uint32_t mode = dispatchMode.exchange(NYMPH_DISPATCH_DIRECT);
+	
+	// Wait for producers which saw the previous mode to finish queueing and signalling, so that
+	// their events are drained below and no drain remains scheduled afterwards.
+	while (dispatchProducers > 0) { std::this_thread::yield(); }
+	
+	if (mode == NYMPH_DISPATCH_THREAD) {
+		dispatchMutex.lock();
+		dispatchRunning = false;
+		dispatchMutex.unlock();
+		dispatchCv.notify_one();
+		dispatchThread.join();
+	}
+	
+	// Run events which were queued after the last drain, once the active drain has finished.
+	while (dispatchScheduled.exchange(true)) { std::this_thread::yield(); }
+	drainDispatch();
+}
+
+
+// --- SET DISPATCH MODE ---
+/**
+	Set where the status, application, disconnect and media read & seek callbacks are called. By
+	default they are called directly on the network threads, which delays the handling of other
+	messages from that remote while a callback runs. The other modes hand the callbacks to a 
+	queue which is emptied by a dispatcher thread or by tasks run on the provided executor. 
+	Callbacks are called in the order in which they were queued. 
+	
+	Event loop mode, if enabled, takes precedence over this setting. An executor has to keep 
+	running tasks until the mode is changed or the client is destroyed, as both wait for the 
+	queued callbacks to finish. For the same reason the mode cannot be changed, nor the client 
+	be destroyed, from within a queued callback.
+	
+	@param mode		The dispatch mode.
+	@param executor	Function which runs the provided task, for NYMPH_DISPATCH_EXECUTOR mode.
+	
+	@return True if the operation succeeded.
+*/
+bool NymphCastClient::setDispatchMode(NymphDispatchMode mode, NymphExecutorFunction executor) {
+	if (mode == NYMPH_DISPATCH_EXECUTOR && !executor) {
+		NYMPH_LOG_ERROR("No executor provided for executor dispatch mode.");
+		return false;
+	}
+	
+	if (isDispatchThread) {
+		NYMPH_LOG_ERROR("Dispatch mode cannot be changed from within a dispatched callback.");
+		return false;
+	}
+	
+	if (dispatchMode != NYMPH_DISPATCH_DIRECT) { stopDispatch(); }
+	if (mode == NYMPH_DISPATCH_DIRECT) { return true; }
+	
+	dispatchExecutor = executor;
+	if (mode == NYMPH_DISPATCH_THREAD) {
+		dispatchRunning = true;
+		dispatchSignal = false;
+		dispatchThread = std::thread(&NymphCastClient::dispatchLoop, this);
+	}
+	
+	dispatchMode = mode;
+	
+	return true;
+}
+
+
+// --- GET DISPATCH STATS ---
+/**
+	Obtain the queue depth and latency statistics of the dispatch queue.
+	
+	@return The statistics.
+*/
+NymphDispatchStats NymphCastClient::getDispatchStats() {
+	NymphDispatchStats stats;
+	stats.dispatched = dispatchCount;
+	stats.depth = dispatchDepth;
+	stats.maxDepth = dispatchMaxDepth;
+	if (stats.dispatched > 0) {
+		stats.avgLatency = (dispatchLatencyTotal / (double) stats.dispatched) / 1000.0;
+	}
+	
+	stats.maxLatency = dispatchLatencyMax / 1000.0;
+	
+	return stats;
+}
+
+
+// --- RESOLVE TIMEOUT ---
+// Determine the timeout for a call. An explicit per-call timeout is used first, then the 
+// per-method, per-handle and default timeouts, in that order.
+long NymphCastClient::resolveTimeout(uint32_t handle, std::string &method, long timeout) {
+	if (timeout > 0) { return timeout; }
+	
+	timeoutsMutex.lock();
+	timeout = defaultTimeout;
+	std::map<std::string, long>::const_iterator mit = methodTimeouts.find(method);
+	std::map<uint32_t, long>::const_iterator hit = handleTimeouts.find(handle);
+	if (mit != methodTimeouts.end()) { timeout = mit->second; }
+	else if (hit != handleTimeouts.end()) { timeout = hit->second; }
+	timeoutsMutex.unlock();
+	
+	return timeout;
+}
+
+
+// Shared state for a remote call which is waited on with a client-side deadline.
+struct TimedCall {
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool done = false;
+	bool abandoned = false;
+	bool success = false;
+	NymphType* returnValue = 0;
+	std::string result;
+};
+
+
+// Set when the last callRemote() on this thread missed its client-side deadline. The call is still
+// in progress on the connection, so dropRemote() leaves the connection alone in that case.
+static thread_local bool callTimedOut = false;
+
+
+// --- CALL REMOTE ---
+// Call a method on the remote, honouring the timeout resolved for this handle and method.
+// NymphRPC applies a single timeout to all calls (set in the constructor). Shorter timeouts are
+// enforced here by performing the call on the task pool and waiting for it with a deadline. A 
+// call which misses its deadline completes in the background and its result is discarded.
+bool NymphCastClient::callRemote(uint32_t handle, std::string method, 
+									std::vector<NymphType*> &values, NymphType* &returnValue, 
+									std::string &result, long timeout) {
+	callTimedOut = false;
+	uint32_t physical;
+	if (!resolveHandle(handle, physical)) {
+		result = "Remote is not connected.";
+		return false;
+	}
+	
+	timeout = resolveTimeout(handle, method, timeout);
+	handle = physical;
+	if (timeout >= rpcTimeout || (isTaskThread && !taskAvailable())) {
+		return NymphRemoteServer::callMethod(handle, method, values, returnValue, result);
+	}
+	
+	std::shared_ptr<TimedCall> call = std::make_shared<TimedCall>();
+	std::vector<NymphType*> params = values;
+	values.clear();
+	bool queued = runTask([call, handle, method, params]() mutable {
+		// Don't perform a call which timed out while still queued, as the caller has already 
+		// been told that it failed.
+		call->mutex.lock();
+		bool abandoned = call->abandoned;
+		call->mutex.unlock();
+		if (abandoned) {
+			for (uint32_t i = 0; i < params.size(); ++i) { delete params[i]; }
+			return;
+		}
+		
+		NymphType* retval = 0;
+		std::string res;
+		bool success = NymphRemoteServer::callMethod(handle, method, params, retval, res);
+		
+		std::unique_lock<std::mutex> lock(call->mutex);
+		if (call->abandoned) {
+			delete retval;
+			return;
+		}
+		
+		call->done = true;
+		call->success = success;
+		call->returnValue = retval;
+		call->result = res;
+		call->cv.notify_one();
+	});
+	
+	// The task pool is shut down, so perform the call on this thread.
+	if (!queued) {
+		return NymphRemoteServer::callMethod(handle, method, params, returnValue, result);
+	}
+	
+	std::unique_lock<std::mutex> lock(call->mutex);
+	if (!call->cv.wait_for(lock, std::chrono::milliseconds(timeout), 
+											[call] { return call->done; })) {
+		call->abandoned = true;
+		callTimedOut = true;
+		result = "Call to " + method + " timed out after " + std::to_string(timeout) + " ms.";
+		return false;
+	}
+	
+	returnValue = call->returnValue;
+	result = call->result;
+	return call->success;
+}
+
+
 // --- CONSTRUCTOR ---
 /**
 	Initialise the remote client instance with default settings.
+	
+	@param timeout	Maximum timeout for remote calls in milliseconds. Per-method and per-handle
+					timeouts can be shorter, but not longer than this.
 */
-NymphCastClient::NymphCastClient() {
+NymphCastClient::NymphCastClient(long timeout) {
 #ifndef NPOCO	
 	// FIXME: Added to work around Poco issue on Windows. Also see auto lib init disable in Makefile.
 	Poco::Net::initializeNetwork();
 #endif
 
 	// Initialise the remote client instance.
-	long timeout = 2000; // 2 seconds.
+	rpcTimeout = timeout;
+	defaultTimeout = timeout;
+	dispatchTail = new DispatchNode;
+	dispatchHead = dispatchTail;
 	NymphRemoteServer::init(logFunction, NYMPH_LOG_LEVEL_INFO, timeout);
 	using namespace std::placeholders;
-	NymphRemoteServer::setDisconnectCallback(std::bind(&NymphCastClient::DisconnectedCallback,
-																	this, _1));
+	NymphRemoteServer::setDisconnectCallback([this](uint32_t session) {
+		dispatchEvent(std::bind(&NymphCastClient::DisconnectedCallback, this, session));
+	});
 	
 	appMessageFunction = 0;
 	statusUpdateFunction = 0;
+	statusDeltaFunction = 0;
 	disconnectedFunction = 0;
+	connectionStateFunction = 0;
 	datacallbacks_set = false;
 }
 
 
 // --- DESTRUCTOR ---
 NymphCastClient::~NymphCastClient() {
+	// Stop reconnecting managed connections.
+	managedMutex.lock();
+	managedStop = true;
+	managedMutex.unlock();
+	managedCv.notify_all();
+	
+	stopDiscovery();
+	
+	// Stop the timer thread.
+	timerMutex.lock();
+	timerRunning = false;
+	timerShutdown = true;
+	timers.clear();
+	timerMutex.unlock();
+	timerCv.notify_all();
+	if (timerThread.joinable()) { timerThread.join(); }
+	
+	// Run any queued callbacks and stop the dispatcher. Waiting for the dispatcher from within a
+	// dispatched callback would never return, so the remaining callbacks are dropped instead.
+	if (isDispatchThread) {
+		NYMPH_LOG_ERROR("Client destroyed from within a dispatched callback.");
+		dispatchMode = NYMPH_DISPATCH_DIRECT;
+		if (dispatchThread.joinable()) { dispatchThread.detach(); }
+	}
+	else if (dispatchMode != NYMPH_DISPATCH_DIRECT) { stopDispatch(); }
+	
+	// Finish any queued tasks before shutting down the RPC layer. No new workers are started
+	// once tasksRunning is false, but keep collecting them until none remain.
+	tasksMutex.lock();
+	tasksRunning = false;
+	tasksMutex.unlock();
+	tasksCv.notify_all();
+	while (true) {
+		std::vector<std::thread> workers;
+		tasksMutex.lock();
+		workers.swap(taskThreads);
+		tasksMutex.unlock();
+		if (workers.empty()) { break; }
+		
+		for (uint32_t i = 0; i < workers.size(); ++i) {
+			workers[i].join();
+		}
+	}
+	
+	// Close pooled media server connections.
+	std::string result;
+	std::map<std::string, std::vector<PooledConnection> >::iterator it;
+	for (it = msPool.begin(); it != msPool.end(); ++it) {
+		for (uint32_t i = 0; i < it->second.size(); ++i) {
+			NymphRemoteServer::disconnect(it->second[i].handle, result);
+		}
+	}
+	
 	NymphRemoteServer::shutdown();
+	
+	// Free the dispatch queue.
+	while (dispatchTail != 0) {
+		DispatchNode* next = dispatchTail->next;
+		delete dispatchTail;
+		dispatchTail = next;
+	}
 }
 
 
@@ -334,8 +929,8 @@ void NymphCastClient::setLogLevel(NymphLogLevels level) {
 // Sets all media file related callbacks. This can only be done before connecting to a server.
 void NymphCastClient::setMediaCallbacks(NymphCallbackMethod readcb, NymphCallbackMethod seekcb) {
 	if (!datacallbacks_set) {
-		NymphRemoteServer::registerCallback("MediaReadCallback", readcb, 0);
-		NymphRemoteServer::registerCallback("MediaSeekCallback", seekcb, 0);
+		NymphRemoteServer::registerCallback("MediaReadCallback", dispatchCallback(readcb), 0);
+		NymphRemoteServer::registerCallback("MediaSeekCallback", dispatchCallback(seekcb), 0);
 		datacallbacks_set = true;
 	}
 }
@@ -363,6 +958,19 @@ void NymphCastClient::setStatusUpdateCallback(StatusUpdateFunction function) {
 }
 
 
+// --- SET STATUS DELTA CALLBACK ---
+/**
+	Set callback to call when the remote sends a status update which differs from the previous 
+	status of that remote. The callback receives a bitmask of NymphStatusField values for the
+	changed fields. The status reference is only valid during the callback.
+	
+	@param function The callback function.
+*/
+void NymphCastClient::setStatusDeltaCallback(StatusDeltaFunction function) {
+	statusDeltaFunction = function;
+}
+
+
 // --- SET DISCONNECT CALLBACK ---
 /**
 	Set the callback to be called when a remote server disconnects.
@@ -374,46 +982,237 @@ void NymphCastClient::setDisconnectCallback(RemoteDisconnectFunction function) {
 }
 
 
-// --- GET APPLICATION LIST ---
+// --- SET DEFAULT TIMEOUT ---
 /**
-	Obtain a list of application available on the remote.
-	
-	@param handle The handle for the remote server.
+	Set the timeout for remote calls which have no per-method or per-handle timeout.
 	
-	@return A string containing the application list, separated by newlines (\n).
+	@param timeout	Timeout in milliseconds. Capped at the timeout provided to the constructor.
 */
-std::string NymphCastClient::getApplicationList(uint32_t handle) {
-	// Request the application list from the remote receiver.
-	// string app_list()
-	std::vector<NymphType*> values;
-	NymphType* returnValue = 0;
-	std::string result;
-	if (!NymphRemoteServer::callMethod(handle, "app_list", values, returnValue, result)) {
-		//std::cout << "Error calling remote method: " << result << std::endl;
-		NYMPH_LOG_ERROR("Error calling remote method: " + result);
-		return std::string();
-	}
+void NymphCastClient::setDefaultTimeout(long timeout) {
+	timeoutsMutex.lock();
+	defaultTimeout = timeout;
+	timeoutsMutex.unlock();
+}
+
+
+// --- SET METHOD TIMEOUT ---
+/**
+	Set the timeout for a specific remote method, e.g. 'playback_status' or 'getFileList'.
 	
-	std::string retStr = returnValue->getString();
+	A method timeout takes precedence over a handle timeout set with setHandleTimeout(). A
+	timeout passed to an individual call overrides both. A call which times out before the 
+	timeout provided to the constructor fails, but does not disconnect the remote, as the call 
+	is still in progress.
 	
-	delete returnValue;
+	@param method	Name of the remote method.
+	@param timeout	Timeout in milliseconds. 0 removes the method timeout.
+*/
+void NymphCastClient::setMethodTimeout(std::string method, long timeout) {
+	timeoutsMutex.lock();
+	if (timeout > 0) { methodTimeouts[method] = timeout; }
+	else { methodTimeouts.erase(method); }
+	timeoutsMutex.unlock();
+}
+
+
+// --- SET HANDLE TIMEOUT ---
+/**
+	Set the timeout for all calls to a specific remote server. Methods with a timeout set 
+	through setMethodTimeout() use that timeout instead.
 	
-	return retStr;
+	@param handle	The handle for the remote server.
+	@param timeout	Timeout in milliseconds. 0 removes the handle timeout.
+*/
+void NymphCastClient::setHandleTimeout(uint32_t handle, long timeout) {
+	timeoutsMutex.lock();
+	if (timeout > 0) { handleTimeouts[handle] = timeout; }
+	else { handleTimeouts.erase(handle); }
+	timeoutsMutex.unlock();
 }
 
 
-// --- SEND APPLICATION MESSAGE ---
+// --- RUN ASYNC ---
 /**
-	Send a string to an application on the remote.
+	Run a call on the client's task pool. This allows any blocking call to be performed 
+	asynchronously, with the call itself signalling its completion. Also see the awaitable
+	API in nymphcast_client_coro.h.
 	
-	@param handle The handle for the remote server.
-	@param appId ID of the remote application.
-	@param message Message to send to the remote application.
-	@param format Result format. 0 is plain text, 1 HTML.
+	@param call	The function to run.
 	
-	@return String with any response from the remote.
+	@return False if the client is shutting down and the call was not queued.
 */
-std::string NymphCastClient::sendApplicationMessage(uint32_t handle, std::string &appId, 
+bool NymphCastClient::runAsync(std::function<void()> call) {
+	return runTask(call);
+}
+
+
+// --- SET EVENT LOOP MODE ---
+/**
+	Enable or disable event loop mode. In this mode all callbacks, including the status, 
+	application, disconnect and media read & seek callbacks, are queued instead of being called 
+	on the network threads. The queue is signalled through the descriptor returned by 
+	getPollFd() and emptied by calling process() from the application's event loop.
+	
+	This should be set before connecting to any remote.
+	
+	@param enable	True to enable event loop mode.
+	
+	@return True if the operation succeeded.
+*/
+bool NymphCastClient::setEventLoopMode(bool enable) {
+	if (enable == eventLoop) { return true; }
+	if (!enable) {
+		eventLoop = false;
+		process();
+		return true;
+	}
+	
+	// The wakeup socket pair is created once and reused when the mode is enabled again, which 
+	// also keeps the descriptor returned by getPollFd() the same.
+	if (!wakeupReceiver) {
+		try {
+			std::unique_ptr<Poco::Net::DatagramSocket> receiver(new Poco::Net::DatagramSocket);
+			std::unique_ptr<Poco::Net::DatagramSocket> sender(new Poco::Net::DatagramSocket);
+			receiver->bind(Poco::Net::SocketAddress("127.0.0.1", 0));
+			sender->connect(receiver->address());
+			receiver->setBlocking(false);
+			wakeupReceiver = std::move(receiver);
+			wakeupSender = std::move(sender);
+		}
+		catch (Poco::Exception &e) {
+			NYMPH_LOG_ERROR("Failed to create event loop wakeup socket: " + e.displayText());
+			return false;
+		}
+	}
+	
+	eventLoop = true;
+	
+	// Signal events which were queued before the mode got enabled.
+	eventsMutex.lock();
+	bool pending = !events.empty();
+	eventsMutex.unlock();
+	if (pending) { signalEventLoop(); }
+	
+	return true;
+}
+
+
+// --- GET POLL FD ---
+/**
+	Obtain the descriptor to watch for readability in event loop mode. When it becomes readable,
+	process() should be called.
+	
+	@return The socket descriptor, or POCO_INVALID_SOCKET if event loop mode was never enabled.
+*/
+poco_socket_t NymphCastClient::getPollFd() {
+	if (!wakeupReceiver) { return POCO_INVALID_SOCKET; }
+	return wakeupReceiver->impl()->sockfd();
+}
+
+
+// --- POST EVENT ---
+/**
+	Queue a function to be run by process() in event loop mode. This can be used to hand the
+	results of runAsync() calls back to the event loop.
+	
+	@param event	The function to run.
+*/
+void NymphCastClient::postEvent(std::function<void()> event) {
+	eventsMutex.lock();
+	bool signal = events.empty();
+	events.push_back(event);
+	eventsMutex.unlock();
+	
+	// Only signal once until the queue has been emptied by process().
+	if (signal) { signalEventLoop(); }
+}
+
+
+// --- SIGNAL EVENT LOOP ---
+// Make the descriptor returned by getPollFd() readable. The wakeup sockets only exist once 
+// event loop mode has been enabled. Before that, events are only run by an explicit process().
+void NymphCastClient::signalEventLoop() {
+	if (!eventLoop) { return; }
+	char c = 0;
+	try {
+		wakeupSender->sendBytes(&c, 1);
+	}
+	catch (Poco::Exception &e) {
+		NYMPH_LOG_ERROR("Failed to signal event loop: " + e.displayText());
+	}
+}
+
+
+// --- PROCESS ---
+/**
+	Run all queued events on the calling thread. To be called from the application's event loop
+	once the descriptor from getPollFd() is readable.
+	
+	@return The number of events processed.
+*/
+uint32_t NymphCastClient::process() {
+	// Clear the wakeup signal before emptying the queue, so that no signal gets lost.
+	char buffer[64];
+	try {
+		while (eventLoop && wakeupReceiver->available() > 0) {
+			wakeupReceiver->receiveBytes(buffer, sizeof(buffer));
+		}
+	}
+	catch (Poco::Exception &e) { }
+	
+	eventsMutex.lock();
+	std::deque<std::function<void()> > queue;
+	queue.swap(events);
+	eventsMutex.unlock();
+	
+	for (uint32_t i = 0; i < queue.size(); ++i) {
+		queue[i]();
+	}
+	
+	return queue.size();
+}
+
+
+// --- GET APPLICATION LIST ---
+/**
+	Obtain a list of application available on the remote.
+	
+	@param handle The handle for the remote server.
+	
+	@return A string containing the application list, separated by newlines (\n).
+*/
+std::string NymphCastClient::getApplicationList(uint32_t handle) {
+	// Request the application list from the remote receiver.
+	// string app_list()
+	std::vector<NymphType*> values;
+	NymphType* returnValue = 0;
+	std::string result;
+	if (!callRemote(handle, "app_list", values, returnValue, result)) {
+		//std::cout << "Error calling remote method: " << result << std::endl;
+		NYMPH_LOG_ERROR("Error calling remote method: " + result);
+		return std::string();
+	}
+	
+	std::string retStr = returnValue->getString();
+	
+	delete returnValue;
+	
+	return retStr;
+}
+
+
+// --- SEND APPLICATION MESSAGE ---
+/**
+	Send a string to an application on the remote.
+	
+	@param handle The handle for the remote server.
+	@param appId ID of the remote application.
+	@param message Message to send to the remote application.
+	@param format Result format. 0 is plain text, 1 HTML.
+	
+	@return String with any response from the remote.
+*/
+std::string NymphCastClient::sendApplicationMessage(uint32_t handle, std::string &appId, 
 														std::string &message, uint8_t format) {
 	// string app_send(uint32 appId, string data, uint8 format)
 	std::vector<NymphType*> values;
@@ -422,7 +1221,7 @@ std::string NymphCastClient::sendApplicationMessage(uint32_t handle, std::string
 	values.push_back(new NymphType(format));
 	NymphType* returnValue = 0;
 	std::string result;
-	if (!NymphRemoteServer::callMethod(handle, "app_send", values, returnValue, result)) {
+	if (!callRemote(handle, "app_send", values, returnValue, result)) {
 		//std::cout << "Error calling remote method: " << result << std::endl;
 		NYMPH_LOG_ERROR("Error calling remote method: " + result);
 		return std::string();
@@ -454,7 +1253,7 @@ std::string NymphCastClient::loadResource(uint32_t handle, std::string &appId, s
 	values.push_back(new NymphType(&name));
 	NymphType* returnValue = 0;
 	std::string result;
-	if (!NymphRemoteServer::callMethod(handle, "app_loadResource", values, returnValue, result)) {
+	if (!callRemote(handle, "app_loadResource", values, returnValue, result)) {
 		//std::cout << "Error calling remote method: " << result << std::endl;
 		NYMPH_LOG_ERROR("Error calling remote method: " + result);
 		return std::string();
@@ -532,12 +1331,22 @@ void NymphCastClient::removeLoopback(std::vector<NYSD_service> &responses) {
 
 // --- FIND SERVERS ---
 /**
-	Find remote NymphCast servers using a NyanSD query.
+	Find remote NymphCast servers using a NyanSD query. If background discovery is active, the
+	receivers currently in the discovery registry are returned instead.
 	
 	@return A vector with any found remotes.
 */
 std::vector<NymphCastRemote> NymphCastClient::findServers() {
-	// Perform a NyanSD service discovery run for NymphCast receivers.
+	std::vector<NymphCastRemote> remotes;
+	if (getDiscovered(false, remotes)) { return remotes; }
+	
+	return queryServers();
+}
+
+
+// --- QUERY SERVERS ---
+// Perform a NyanSD service discovery run for NymphCast receivers.
+std::vector<NymphCastRemote> NymphCastClient::queryServers() {
 	std::vector<NYSD_query> queries;
 	std::vector<NYSD_service> responses;
 	std::vector<NymphCastRemote> remotes;
@@ -546,7 +1355,16 @@ std::vector<NymphCastRemote> NymphCastClient::findServers() {
 	query.protocol = NYSD_PROTOCOL_ALL;
 	query.filter = "nymphcast";
 	queries.push_back(query);
-	if (!NyanSD::sendQuery(4004, queries, responses)) { return remotes; }
+	if (!NyanSD::sendQuery(4004, queries, responses, discoveryMulticast)) { return remotes; }
+	
+	return serverRemotes(responses);
+}
+
+
+// --- SERVER REMOTES ---
+// Convert receiver query responses into remotes.
+std::vector<NymphCastRemote> NymphCastClient::serverRemotes(std::vector<NYSD_service> &responses) {
+	std::vector<NymphCastRemote> remotes;
 	
 	// Process responses. 
 	// Filter out loopback addresses.
@@ -577,14 +1395,86 @@ std::vector<NymphCastRemote> NymphCastClient::findServers() {
 }
 
 
+// --- FIND SERVERS ---
+/**
+	Find remote NymphCast servers using a NyanSD query, passing each receiver to the callback as
+	soon as its response arrives. The search can end early once an expected number of receivers 
+	or a receiver with a specific name has been found, or when the callback returns false.
+	
+	Loopback responses are only reported at the end of the search, and only for receivers which 
+	did not respond on another address.
+	
+	@param function	Callback called for each found receiver. Return false to end the search.
+	@param expected	Number of receivers after which to end the search. 0 to not limit.
+	@param name		Name of the receiver after which to end the search. Empty to ignore.
+	
+	@return False if the query could not be sent.
+*/
+bool NymphCastClient::findServers(RemoteFoundFunction function, uint32_t expected, 
+																			std::string name) {
+	std::vector<NYSD_query> queries;
+	std::vector<NymphCastRemote> remotes;
+	std::vector<NymphCastRemote> loopback;
+	bool stopped = false;
+	
+	NYSD_query query;
+	query.protocol = NYSD_PROTOCOL_ALL;
+	query.filter = "nymphcast";
+	queries.push_back(query);
+	bool res = NyanSD::sendQuery(4004, queries, [&](NYSD_service &service) {
+		NymphCastRemote rm;
+		rm.ipv4 = NyanSD::ipv4_uintToString(service.ipv4);
+		rm.ipv6 = service.ipv6;
+		rm.name = service.hostname;
+		rm.port = service.port;
+		if (isDuplicateName(remotes, rm)) { return true; }
+		
+		// Hold loopback responses back until the end, in case another address responds.
+		if (rm.ipv4.compare(0, 4, "127.") == 0) {
+			if (!isDuplicateName(loopback, rm)) { loopback.push_back(rm); }
+			return true;
+		}
+		
+		remotes.push_back(rm);
+		if (!function(rm) || (expected > 0 && remotes.size() >= expected) || 
+												(!name.empty() && rm.name == name)) {
+			stopped = true;
+			return false;
+		}
+		
+		return true;
+	}, discoveryMulticast);
+	
+	if (!res) { return false; }
+	
+	for (uint32_t i = 0; i < loopback.size() && !stopped; ++i) {
+		if (isDuplicateName(remotes, loopback[i])) { continue; }
+		remotes.push_back(loopback[i]);
+		if (!function(loopback[i])) { break; }
+	}
+	
+	return true;
+}
+
+
 // --- FIND SHARES ---
 /**
-	Find any NymphCast Media Servers on the network using a NyanSD query.
+	Find any NymphCast Media Servers on the network using a NyanSD query. If background discovery
+	is active, the media servers currently in the discovery registry are returned instead.
 	
 	@return Vector containing any found media server instances.
 */
 std::vector<NymphCastRemote> NymphCastClient::findShares() {
-	// Perform NyanSD service discovery query for NymphCast media servers.
+	std::vector<NymphCastRemote> remotes;
+	if (getDiscovered(true, remotes)) { return remotes; }
+	
+	return queryShares();
+}
+
+
+// --- QUERY SHARES ---
+// Perform NyanSD service discovery query for NymphCast media servers.
+std::vector<NymphCastRemote> NymphCastClient::queryShares() {
 	std::vector<NYSD_query> queries;
 	std::vector<NYSD_service> responses;
 	std::vector<NymphCastRemote> remotes;
@@ -593,7 +1483,16 @@ std::vector<NymphCastRemote> NymphCastClient::findShares() {
 	query.protocol = NYSD_PROTOCOL_ALL;
 	query.filter = "nymphcast_mediaserver";
 	queries.push_back(query);
-	if (!NyanSD::sendQuery(4005, queries, responses)) { return remotes; }
+	if (!NyanSD::sendQuery(4005, queries, responses, discoveryMulticast)) { return remotes; }
+	
+	return shareRemotes(responses);
+}
+
+
+// --- SHARE REMOTES ---
+// Convert media server query responses into remotes.
+std::vector<NymphCastRemote> NymphCastClient::shareRemotes(std::vector<NYSD_service> &responses) {
+	std::vector<NymphCastRemote> remotes;
 	
 	// Process responses.
 	for (int i = 0; i < responses.size(); ++i) {
@@ -617,159 +1516,1219 @@ std::vector<NymphCastRemote> NymphCastClient::findShares() {
 }
 
 
-// --- CONNECT SERVER ---
+// --- DISCOVER ALL ---
 /**
-	Attempt to connect to the specified remote NymphCast server.
+	Find both NymphCast receivers and media servers in a single NyanSD query run. The receiver 
+	query is sent to the receiver port and the media server query to the media server port, with
+	the responses to both received in the same response window.
 	
-	@param ip		The IP address of the target server.
-	@param handle 	The new handle for the remote server.
+	@param receivers	Vector to which any found receivers are added.
+	@param mediaServers	Vector to which any found media servers are added.
 	
-	@return True if the operation succeeded.
+	@return False if the query could not be sent.
 */
-bool NymphCastClient::connectServer(std::string ip, uint32_t port, uint32_t &handle) {
-	std::string serverip = "127.0.0.1";
-	uint32_t serverport = 4004;
-	if (!ip.empty()) {
-		serverip = ip;
+bool NymphCastClient::discoverAll(std::vector<NymphCastRemote> &receivers, 
+											std::vector<NymphCastRemote> &mediaServers) {
+	std::vector<NYSD_query> queries;
+	NYSD_query query;
+	query.protocol = NYSD_PROTOCOL_ALL;
+	query.filter = "nymphcast";
+	query.port = 4004;
+	queries.push_back(query);
+	query.filter = "nymphcast_mediaserver";
+	query.port = 4005;
+	queries.push_back(query);
+	
+	std::vector<uint16_t> ports;
+	ports.push_back(4004);
+	ports.push_back(4005);
+	
+	// Split the responses by service.
+	std::vector<NYSD_service> responses[2];
+	bool res = NyanSD::sendQuery(ports, queries, [&responses](NYSD_service &service) {
+		if (service.service == "nymphcast") { responses[0].push_back(service); }
+		else if (service.service == "nymphcast_mediaserver") { responses[1].push_back(service); }
+		return true;
+	}, discoveryMulticast);
+	
+	if (!res) { return false; }
+	
+	std::vector<NymphCastRemote> remotes = serverRemotes(responses[0]);
+	receivers.insert(receivers.end(), remotes.begin(), remotes.end());
+	remotes = shareRemotes(responses[1]);
+	mediaServers.insert(mediaServers.end(), remotes.begin(), remotes.end());
+	
+	return true;
+}
+
+
+// --- START DISCOVERY ---
+/**
+	Start background discovery. Receivers and media servers are queried periodically and kept in
+	a registry until they have not responded for the duration of the TTL. While active, 
+	findServers() and findShares() return the registry contents without querying the network.
+	
+	@param interval	Time between discovery runs, in milliseconds.
+	@param ttl		Time after which a remote which no longer responds is removed, in milliseconds.
+*/
+void NymphCastClient::startDiscovery(uint32_t interval, uint32_t ttl) {
+	discoveryMutex.lock();
+	discoveryInterval = interval;
+	discoveryTtl = ttl;
+	if (discoveryActive) {
+		discoveryMutex.unlock();
+		return;
 	}
 	
-	if (port > 0) {
-		serverport = port;
+	discoveryActive = true;
+	uint32_t generation = ++discoveryGeneration;
+	discoveryMutex.unlock();
+	
+	runTask(std::bind(&NymphCastClient::runDiscovery, this, generation));
+}
+
+
+// --- STOP DISCOVERY ---
+/**
+	Stop background discovery and clear the discovery registry.
+*/
+void NymphCastClient::stopDiscovery() {
+	discoveryMutex.lock();
+	discoveryActive = false;
+	discoveryGeneration++;
+	discoveryReady = false;
+	discovered[0].clear();
+	discovered[1].clear();
+	discoveryMutex.unlock();
+}
+
+
+// --- SET MULTICAST DISCOVERY ---
+/**
+	Send discovery queries to the NyanSD multicast groups instead of broadcasting them on each
+	network interface. This requires receivers and media servers which listen for multicast
+	queries.
+	
+	@param enable	True to use multicast discovery.
+*/
+void NymphCastClient::setMulticastDiscovery(bool enable) {
+	discoveryMulticast = enable;
+}
+
+
+// --- SET DISCOVERY CALLBACK ---
+/**
+	Set the callback for remotes appearing in or disappearing from the discovery registry.
+	
+	@param function The callback function.
+*/
+void NymphCastClient::setDiscoveryCallback(RemoteDiscoveryFunction function) {
+	discoveryFunction = function;
+}
+
+
+// --- RUN DISCOVERY ---
+// Single background discovery run. Updates the registry with the found remotes, expires remotes
+// which have not been seen within the TTL and schedules the next run.
+void NymphCastClient::runDiscovery(uint32_t generation) {
+	std::vector<NymphCastRemote> found[2];
+	discoverAll(found[0], found[1]);
+	
+	std::vector<NymphCastRemote> appeared[2];
+	std::vector<NymphCastRemote> gone[2];
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	
+	discoveryMutex.lock();
+	if (!discoveryActive || generation != discoveryGeneration) {
+		discoveryMutex.unlock();
+		return;
 	}
+	
+	for (uint32_t t = 0; t < 2; ++t) {
+		for (uint32_t i = 0; i < found[t].size(); ++i) {
+			std::string key = found[t][i].name + ":" + std::to_string(found[t][i].port);
+			std::map<std::string, DiscoveredRemote>::iterator it = discovered[t].find(key);
+			if (it == discovered[t].end()) {
+				appeared[t].push_back(found[t][i]);
+			}
+			
+			DiscoveredRemote& dr = discovered[t][key];
+			dr.remote = found[t][i];
+			dr.lastSeen = now;
+		}
 		
+		std::map<std::string, DiscoveredRemote>::iterator it = discovered[t].begin();
+		while (it != discovered[t].end()) {
+			if (now - it->second.lastSeen > std::chrono::milliseconds(discoveryTtl)) {
+				gone[t].push_back(it->second.remote);
+				it = discovered[t].erase(it);
+			}
+			else { ++it; }
+		}
+	}
+	
+	discoveryReady = true;
+	uint32_t interval = discoveryInterval;
+	discoveryMutex.unlock();
+	
+	if (discoveryFunction) {
+		for (uint32_t t = 0; t < 2; ++t) {
+			for (uint32_t i = 0; i < appeared[t].size(); ++i) {
+				dispatchEvent(std::bind(discoveryFunction, appeared[t][i], t == 1, 
+															NYMPH_DISCOVERY_APPEARED));
+			}
+			
+			for (uint32_t i = 0; i < gone[t].size(); ++i) {
+				dispatchEvent(std::bind(discoveryFunction, gone[t][i], t == 1, 
+															NYMPH_DISCOVERY_DISAPPEARED));
+			}
+		}
+	}
+	
+	scheduleTask(interval, std::bind(&NymphCastClient::runDiscovery, this, generation));
+}
+
+
+// --- GET DISCOVERED ---
+// Copy the receivers or media servers in the discovery registry. Returns false if background
+// discovery is not active, or the first run hasn't completed yet.
+bool NymphCastClient::getDiscovered(bool mediaServers, std::vector<NymphCastRemote> &remotes) {
+	discoveryMutex.lock();
+	if (!discoveryActive || !discoveryReady) {
+		discoveryMutex.unlock();
+		return false;
+	}
+	
+	std::map<std::string, DiscoveredRemote>& registry = discovered[mediaServers ? 1 : 0];
+	std::map<std::string, DiscoveredRemote>::const_iterator it;
+	for (it = registry.begin(); it != registry.end(); ++it) {
+		remotes.push_back(it->second.remote);
+	}
+	
+	discoveryMutex.unlock();
+	
+	return true;
+}
+
+
+// --- REGISTER CALLBACKS ---
+// Register the callbacks which remote servers call on this client.
+void NymphCastClient::registerCallbacks() {
 	// Register callback and send message with its ID to the server. Then wait
 	// for the callback to be called.
 	using namespace std::placeholders;
 	if (!datacallbacks_set) {
 		NymphRemoteServer::registerCallback("MediaReadCallback", 
-										std::bind(&NymphCastClient::MediaReadCallback,
-																	this, _1, _2, _3), 0);
+							dispatchCallback(std::bind(&NymphCastClient::MediaReadCallback,
+																	this, _1, _2, _3)), 0);
 		NymphRemoteServer::registerCallback("MediaSeekCallback", 
-										std::bind(&NymphCastClient::MediaSeekCallback,
-																	this, _1, _2, _3), 0);
+							dispatchCallback(std::bind(&NymphCastClient::MediaSeekCallback,
+																	this, _1, _2, _3)), 0);
 		datacallbacks_set = true;
 	}
 	
-	NymphRemoteServer::registerCallback("MediaStopCallback", 
-										std::bind(&NymphCastClient::MediaStopCallback,
-																	this, _1, _2, _3), 0);
-	NymphRemoteServer::registerCallback("MediaStatusCallback", 
-										std::bind(&NymphCastClient::MediaStatusCallback,
-																	this, _1, _2, _3), 0);
-		
-	// Connect to the remote server.
+	NymphRemoteServer::registerCallback("MediaStopCallback", 
+							dispatchCallback(std::bind(&NymphCastClient::MediaStopCallback,
+																	this, _1, _2, _3)), 0);
+	NymphRemoteServer::registerCallback("MediaStatusCallback", 
+							dispatchCallback(std::bind(&NymphCastClient::MediaStatusCallback,
+																	this, _1, _2, _3)), 0);
+	NymphRemoteServer::registerCallback("ReceiveFromAppCallback", 
+							dispatchCallback(std::bind(&NymphCastClient::ReceiveFromAppCallback,
+																	this, _1, _2, _3)), 0);
+}
+
+
+// --- CONNECT REMOTE ---
+// Connect to the remote server and register this client with it. Callbacks have to be 
+// registered already.
+bool NymphCastClient::connectRemote(std::string ip, uint32_t port, uint32_t &handle, 
+																		std::string &result) {
+	std::string serverip = "127.0.0.1";
+	uint32_t serverport = 4004;
+	if (!ip.empty()) {
+		serverip = ip;
+	}
+	
+	if (port > 0) {
+		serverport = port;
+	}
+		
+	// Connect to the remote server.
+	if (!NymphRemoteServer::connect(serverip, serverport, handle, 0, result)) {
+		//std::cout << "Connecting to remote server failed: " << result << std::endl;
+		NYMPH_LOG_ERROR("Connecting to remote server failed: " + result);
+		std::string dresult;
+		NymphRemoteServer::disconnect(handle, dresult);
+		return false;
+	}
+	
+	// Send message and wait for response.
+	std::vector<NymphType*> values;
+	values.push_back(new NymphType(&clientId));
+	NymphType* returnValue = 0;
+	if (!callRemote(handle, "connect", values, returnValue, result)) {
+		//std::cout << "Error calling remote method: " << result << std::endl;
+		NYMPH_LOG_ERROR("Error calling remote method: " + result);
+		std::string dresult;
+		NymphRemoteServer::disconnect(handle, dresult);
+		return false;
+	}
+	
+	delete returnValue;
+	
+	
+	// The remote NymphCast server works in a pull fashion, which means that we have to register
+	// a callback with the server. This callback will be called whenever the server needs more
+	// data from the file which we are streaming.
+	
+	return true;
+}
+
+
+// --- CONNECT SERVER ---
+/**
+	Attempt to connect to the specified remote NymphCast server.
+	
+	@param ip		The IP address of the target server.
+	@param handle 	The new handle for the remote server.
+	
+	@return True if the operation succeeded.
+*/
+bool NymphCastClient::connectServer(std::string ip, uint32_t port, uint32_t &handle) {
+	registerCallbacks();
+	
+	std::string result;
+	return connectRemote(ip, port, handle, result);
+}
+
+
+// Shared state for a connectServers() batch. Workers may outlive the call if the deadline
+// expires while a connection attempt is in progress.
+struct ConnectBatch {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::vector<NymphConnectResult> results;
+	uint32_t next = 0;
+	uint32_t active = 0;
+	bool expired = false;
+};
+
+
+// --- CONNECT SERVERS ---
+/**
+	Connect to multiple remote NymphCast servers concurrently.
+	
+	Remotes which could not be connected to before the deadline are returned as failed. Any
+	connection which completes after the deadline is closed again. The IPv4 address of a remote
+	is used if set, else its IPv6 address. Remotes without either fail.
+	
+	@param remotes		The remote servers to connect to.
+	@param maxInFlight	Maximum number of simultaneous connection attempts.
+	@param deadline		Time in milliseconds after which the call returns.
+	@param cancel		Optional flag which cancels the remaining attempts when set.
+	
+	@return Vector with a result for each remote, in the same order as the provided remotes.
+*/
+std::vector<NymphConnectResult> NymphCastClient::connectServers(std::vector<NymphCastRemote> remotes,
+														uint32_t maxInFlight, uint32_t deadline,
+														NymphCancelFlag cancel) {
+	registerCallbacks();
+	
+	std::shared_ptr<ConnectBatch> batch = std::make_shared<ConnectBatch>();
+	batch->results.resize(remotes.size());
+	for (uint32_t i = 0; i < remotes.size(); ++i) {
+		batch->results[i].remote = remotes[i];
+		batch->results[i].error = "Deadline exceeded";
+	}
+	
+	if (maxInFlight == 0) { maxInFlight = 1; }
+	if (maxInFlight > tasksMax) { maxInFlight = tasksMax; }
+	if (maxInFlight > remotes.size()) { maxInFlight = remotes.size(); }
+	
+	// Each worker keeps taking the next remote until none are left, the deadline expired or the
+	// batch got cancelled.
+	auto worker = [this, batch, cancel]() {
+		std::unique_lock<std::mutex> lock(batch->mutex);
+		while (!batch->expired && !(cancel && *cancel) && batch->next < batch->results.size()) {
+			uint32_t idx = batch->next++;
+			NymphCastRemote remote = batch->results[idx].remote;
+			lock.unlock();
+			
+			// Use the IPv6 address if the remote has no IPv4 address. An entry without any 
+			// address fails, instead of connecting to the local host.
+			uint32_t handle = 0;
+			std::string result = "No address for remote";
+			std::string ip = remote.ipv4.empty() ? remote.ipv6 : remote.ipv4;
+			bool connected = !ip.empty() && connectRemote(ip, remote.port, handle, result);
+			
+			lock.lock();
+			if (batch->expired) {
+				if (connected) {
+					lock.unlock();
+					markDropped(handle);
+					closeRemote(handle);
+					lock.lock();
+				}
+				
+				continue;
+			}
+			
+			batch->results[idx].handle = handle;
+			batch->results[idx].connected = connected;
+			batch->results[idx].error = result;
+			if (connected) { batch->results[idx].error.clear(); }
+		}
+		
+		batch->active--;
+		batch->cv.notify_all();
+	};
+	
+	batch->active = maxInFlight;
+	for (uint32_t i = 0; i < maxInFlight; ++i) {
+		if (!runTask(worker)) {
+			std::unique_lock<std::mutex> lock(batch->mutex);
+			batch->active--;
+		}
+	}
+	
+	// Wait for all workers to finish, or the deadline to expire. The cancel flag is checked 
+	// every 50 ms.
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + 
+															std::chrono::milliseconds(deadline);
+	std::unique_lock<std::mutex> lock(batch->mutex);
+	while (batch->active > 0 && std::chrono::steady_clock::now() < end) {
+		if (cancel && *cancel) { break; }
+		
+		std::chrono::steady_clock::time_point slice = std::chrono::steady_clock::now() + 
+															std::chrono::milliseconds(50);
+		batch->cv.wait_until(lock, (slice < end) ? slice : end);
+	}
+	
+	// Remotes which were not connected when the batch got cancelled are reported as such, 
+	// including those which no worker got to.
+	if (cancel && *cancel) {
+		for (uint32_t i = 0; i < batch->results.size(); ++i) {
+			if (!batch->results[i].connected) { batch->results[i].error = "Cancelled"; }
+		}
+	}
+	
+	batch->expired = true;
+	
+	return batch->results;
+}
+
+
+// --- DISCONNECT SERVER ---
+/**
+	Disconnect from the remote server.
+	
+	@param handle The handle for the remote server.
+	
+	@return True if the operation succeeded.
+*/
+bool NymphCastClient::disconnectServer(uint32_t handle) {
+	// TODO: don't shutdown entire remote server.
+	
+	// Remove the callbacks.
+	NymphRemoteServer::removeCallback("MediaReadCallback");
+	NymphRemoteServer::removeCallback("MediaStopCallback");
+	NymphRemoteServer::removeCallback("MediaSeekCallback");
+	
+	timeoutsMutex.lock();
+	handleTimeouts.erase(handle);
+	timeoutsMutex.unlock();
+	
+	disableHeartbeat(handle);
+	
+	statusMutex.lock();
+	statusCache.erase(handle);
+	statusMutex.unlock();
+	
+	unsubscribeStatus(handle);
+	
+	// A managed connection is no longer reconnected once disconnected by the user.
+	uint32_t physical = handle;
+	if (handle & NYMPH_MANAGED_HANDLE) {
+		managedMutex.lock();
+		std::map<uint32_t, ManagedConnection>::iterator it = managed.find(handle);
+		if (it == managed.end()) {
+			managedMutex.unlock();
+			return false;
+		}
+		
+		bool connected = it->second.connected;
+		physical = it->second.handle;
+		physicalToManaged.erase(physical);
+		if (connected) { droppedPhysical.insert(physical); }
+		managed.erase(it);
+		managedMutex.unlock();
+		
+		if (!connected) { return true; }
+	}
+	
+	return closeRemote(physical);
+}
+
+
+// --- CLOSE REMOTE ---
+// Send the disconnect command to the remote server and close the connection.
+bool NymphCastClient::closeRemote(uint32_t handle) {
+	// Send disconnect command.
+	std::string result;
+	std::vector<NymphType*> values;
+	NymphType* returnValue = 0;
+	if (!callRemote(handle, "disconnect", values, returnValue, result)) {
+		//std::cout << "Error calling remote method: " << result << std::endl;
+		NYMPH_LOG_ERROR("Error calling remote method: " + result);
+		NymphRemoteServer::disconnect(handle, result);
+		return false;
+	}
+	
+	delete returnValue;
+	
+	// Shutdown.
+	NymphRemoteServer::disconnect(handle, result);
+	
+	return true;
+}
+
+
+// --- RESOLVE HANDLE ---
+// Translate a managed handle into the handle of its current connection. Other handles are 
+// returned as-is. Returns false if the managed connection is currently down.
+bool NymphCastClient::resolveHandle(uint32_t handle, uint32_t &physical) {
+	if (!(handle & NYMPH_MANAGED_HANDLE)) {
+		physical = handle;
+		return true;
+	}
+	
+	managedMutex.lock();
+	std::map<uint32_t, ManagedConnection>::const_iterator it = managed.find(handle);
+	if (it == managed.end() || !it->second.connected) {
+		managedMutex.unlock();
+		return false;
+	}
+	
+	physical = it->second.handle;
+	managedMutex.unlock();
+	
+	return true;
+}
+
+
+// --- USER HANDLE ---
+// Translate a connection handle into the handle the user knows it by. 
+uint32_t NymphCastClient::userHandle(uint32_t session) {
+	managedMutex.lock();
+	std::map<uint32_t, uint32_t>::const_iterator it = physicalToManaged.find(session);
+	if (it != physicalToManaged.end()) { session = it->second; }
+	managedMutex.unlock();
+	
+	return session;
+}
+
+
+// --- DROP REMOTE ---
+// Close the connection to a remote after a failed call. Managed connections are reconnected.
+void NymphCastClient::dropRemote(uint32_t handle) {
+	// A call which missed a client-side deadline says nothing about the connection.
+	if (callTimedOut) { return; }
+	
+	statusMutex.lock();
+	statusCache.erase(handle);
+	statusMutex.unlock();
+	
+	std::string result;
+	if (!(handle & NYMPH_MANAGED_HANDLE)) {
+		NymphRemoteServer::disconnect(handle, result);
+		return;
+	}
+	
+	uint32_t physical;
+	if (!resolveHandle(handle, physical)) { return; }
+	
+	markDropped(physical);
+	NymphRemoteServer::disconnect(physical, result);
+	startReconnect(physical);
+}
+
+
+// --- MARK DROPPED ---
+// Mark a connection as closed by the client, before disconnecting it. Its disconnect callback 
+// from NymphRPC is then ignored, as the client reports or reconnects it itself. For a managed 
+// connection the callback would otherwise reach the user with the connection handle, as the
+// managed mapping is gone by the time it arrives.
+void NymphCastClient::markDropped(uint32_t physical) {
+	managedMutex.lock();
+	droppedPhysical.insert(physical);
+	managedMutex.unlock();
+}
+
+
+// --- START RECONNECT ---
+// Mark the managed connection using this connection handle as down and start reconnecting it.
+// Returns false if the handle does not belong to a managed connection.
+bool NymphCastClient::startReconnect(uint32_t session) {
+	managedMutex.lock();
+	std::map<uint32_t, uint32_t>::iterator pit = physicalToManaged.find(session);
+	if (pit == physicalToManaged.end()) {
+		managedMutex.unlock();
+		return false;
+	}
+	
+	uint32_t handle = pit->second;
+	physicalToManaged.erase(pit);
+	managed[handle].connected = false;
+	managedMutex.unlock();
+	
+	NYMPH_LOG_INFO("Connection lost, reconnecting managed handle " + std::to_string(handle));
+	if (connectionStateFunction) {
+		dispatchEvent(std::bind(connectionStateFunction, handle, NYMPH_CONNECTION_RECONNECTING));
+	}
+	
+	runTask(std::bind(&NymphCastClient::reconnectManaged, this, handle));
+	
+	return true;
+}
+
+
+// --- RECONNECT MANAGED ---
+// Reconnect a managed connection using exponential backoff with jitter, then restore its 
+// receiver registration and slave configuration.
+void NymphCastClient::reconnectManaged(uint32_t handle) {
+	static thread_local std::mt19937 rng(std::random_device{}());
+	uint32_t attempt = 0;
+	while (true) {
+		managedMutex.lock();
+		std::map<uint32_t, ManagedConnection>::iterator it = managed.find(handle);
+		if (it == managed.end() || managedStop) {
+			// Disconnected by the user or shutting down.
+			managedMutex.unlock();
+			return;
+		}
+		
+		std::string ip = it->second.ip;
+		uint32_t port = it->second.port;
+		std::vector<NymphCastRemote> slaves = it->second.slaves;
+		
+		if (reconnectMaxAttempts > 0 && attempt >= reconnectMaxAttempts) {
+			managed.erase(it);
+			managedMutex.unlock();
+			
+			NYMPH_LOG_ERROR("Giving up reconnecting managed handle " + std::to_string(handle));
+			if (connectionStateFunction) {
+				dispatchEvent(std::bind(connectionStateFunction, handle, NYMPH_CONNECTION_FAILED));
+			}
+			
+			return;
+		}
+		
+		// Wait a random time between half and the full backoff delay.
+		uint64_t delay = reconnectMaxDelay;
+		if (attempt < 32 && ((uint64_t) reconnectInitialDelay << attempt) < reconnectMaxDelay) {
+			delay = (uint64_t) reconnectInitialDelay << attempt;
+		}
+		
+		std::uniform_int_distribution<uint64_t> dist(delay / 2, delay);
+		std::unique_lock<std::mutex> lock(managedMutex, std::adopt_lock);
+		managedCv.wait_for(lock, std::chrono::milliseconds(dist(rng)), 
+															[this] { return managedStop; });
+		if (managedStop) { return; }
+		lock.unlock();
+		
+		attempt++;
+		uint32_t physical;
+		std::string result;
+		registerCallbacks();
+		if (!connectRemote(ip, port, physical, result)) { continue; }
+		
+		// Restore the slave configuration.
+		if (!slaves.empty() && !sendSlaves(physical, slaves)) {
+			NYMPH_LOG_ERROR("Failed to restore slaves for managed handle " + 
+																	std::to_string(handle));
+		}
+		
+		managedMutex.lock();
+		it = managed.find(handle);
+		if (it == managed.end() || managedStop) {
+			// Disconnected by the user in the meantime.
+			droppedPhysical.insert(physical);
+			managedMutex.unlock();
+			closeRemote(physical);
+			return;
+		}
+		
+		it->second.handle = physical;
+		it->second.connected = true;
+		physicalToManaged[physical] = handle;
+		managedMutex.unlock();
+		
+		NYMPH_LOG_INFO("Reconnected managed handle " + std::to_string(handle));
+		if (connectionStateFunction) {
+			dispatchEvent(std::bind(connectionStateFunction, handle, NYMPH_CONNECTION_CONNECTED));
+		}
+		
+		return;
+	}
+}
+
+
+// --- CONNECT SERVER MANAGED ---
+/**
+	Connect to a remote NymphCast server as a managed connection. If the connection is lost, it 
+	is automatically re-established using exponential backoff, after which the slave 
+	configuration set using addSlaves() is restored. The returned handle stays valid across 
+	reconnects until disconnectServer() is called for it.
+	
+	@param ip		The IP address of the target server.
+	@param port		The port of the target server. 0 for the default port.
+	@param handle 	The new managed handle for the remote server.
+	
+	@return True if the operation succeeded.
+*/
+bool NymphCastClient::connectServerManaged(std::string ip, uint32_t port, uint32_t &handle) {
+	registerCallbacks();
+	
+	uint32_t physical;
+	std::string result;
+	if (!connectRemote(ip, port, physical, result)) { return false; }
+	
+	managedMutex.lock();
+	handle = NYMPH_MANAGED_HANDLE | nextManagedHandle++;
+	ManagedConnection& mc = managed[handle];
+	mc.ip = ip;
+	mc.port = port;
+	mc.handle = physical;
+	mc.connected = true;
+	physicalToManaged[physical] = handle;
+	managedMutex.unlock();
+	
+	return true;
+}
+
+
+// --- SET RECONNECT POLICY ---
+/**
+	Configure the backoff used for reconnecting managed connections.
+	
+	@param initialDelay	Delay before the first reconnect attempt in milliseconds.
+	@param maxDelay		Maximum delay between attempts in milliseconds.
+	@param maxAttempts	Number of attempts before giving up. 0 to keep trying.
+*/
+void NymphCastClient::setReconnectPolicy(uint32_t initialDelay, uint32_t maxDelay, 
+																		uint32_t maxAttempts) {
+	managedMutex.lock();
+	reconnectInitialDelay = initialDelay;
+	reconnectMaxDelay = maxDelay;
+	reconnectMaxAttempts = maxAttempts;
+	managedMutex.unlock();
+}
+
+
+// --- SET CONNECTION STATE CALLBACK ---
+/**
+	Set the callback to be called when the state of a managed connection changes.
+	
+	@param function The callback function.
+*/
+void NymphCastClient::setConnectionStateCallback(ConnectionStateFunction function) {
+	connectionStateFunction = function;
+}
+
+
+// --- TIMER LOOP ---
+// Runs scheduled tasks and sends a heartbeat to each handle whose interval has elapsed. The 
+// tasks and heartbeats themselves run on the task pool, so that a slow remote does not delay 
+// the others.
+void NymphCastClient::timerLoop() {
+	std::unique_lock<std::mutex> lock(timerMutex);
+	while (timerRunning) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::time_point wake = now + std::chrono::seconds(60);
+		while (!timers.empty() && timers.begin()->first <= now) {
+			runTask(timers.begin()->second);
+			timers.erase(timers.begin());
+		}
+		
+		if (!timers.empty()) { wake = timers.begin()->first; }
+		
+		std::map<uint32_t, Heartbeat>::iterator it;
+		for (it = heartbeats.begin(); it != heartbeats.end(); ++it) {
+			Heartbeat& hb = it->second;
+			if (!hb.inFlight && hb.next <= now) {
+				hb.inFlight = true;
+				hb.next = now + std::chrono::milliseconds(hb.interval);
+				uint32_t timeout = hb.interval;
+				if (timeout > rpcTimeout) { timeout = rpcTimeout; }
+				runTask(std::bind(&NymphCastClient::sendHeartbeat, this, it->first, timeout));
+			}
+			
+			if (hb.next < wake) { wake = hb.next; }
+		}
+		
+		timerCv.wait_until(lock, wake);
+	}
+}
+
+
+// --- START TIMER ---
+// Start the timer thread if it isn't running yet. The timer mutex must be held by the caller.
+bool NymphCastClient::startTimer() {
+	if (timerShutdown) { return false; }
+	if (!timerRunning) {
+		timerRunning = true;
+		timerThread = std::thread(&NymphCastClient::timerLoop, this);
+	}
+	
+	return true;
+}
+
+
+// --- SCHEDULE TASK ---
+// Run a task on the task pool after the provided delay in milliseconds.
+void NymphCastClient::scheduleTask(uint32_t delay, std::function<void()> task) {
+	timerMutex.lock();
+	if (!startTimer()) {
+		timerMutex.unlock();
+		return;
+	}
+	
+	timers.insert(std::make_pair(std::chrono::steady_clock::now() + 
+												std::chrono::milliseconds(delay), task));
+	timerMutex.unlock();
+	timerCv.notify_one();
+}
+
+
+// --- SEND HEARTBEAT ---
+// Perform a single heartbeat call and update the RTT statistics for the handle. Once the 
+// maximum number of consecutive misses is reached, the remote is treated as disconnected.
+void NymphCastClient::sendHeartbeat(uint32_t handle, uint32_t timeout) {
+	// Don't count misses while a managed connection is being reconnected.
+	uint32_t physical;
+	if (!resolveHandle(handle, physical)) {
+		timerMutex.lock();
+		std::map<uint32_t, Heartbeat>::iterator it = heartbeats.find(handle);
+		if (it != heartbeats.end()) { it->second.inFlight = false; }
+		timerMutex.unlock();
+		return;
+	}
+	
+	std::vector<NymphType*> values;
+	NymphType* returnValue = 0;
+	std::string result;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool success = callRemote(handle, "playback_status", values, returnValue, result, timeout);
+	double rtt = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - 
+																					start).count();
+	if (success) {
+		// The reply is a full playback status, so use it to keep the status cache fresh.
+		NymphPlaybackStatus stat;
+		std::string missing;
+		if (decodeStatus(returnValue, stat, missing)) {
+			updateStatusCache(handle, stat);
+		}
+		else {
+			NYMPH_LOG_WARNING("Heartbeat: Failed to find value '" + missing + "' in struct.");
+		}
+		
+		delete returnValue;
+	}
+	
+	timerMutex.lock();
+	std::map<uint32_t, Heartbeat>::iterator it = heartbeats.find(handle);
+	if (it == heartbeats.end()) {
+		timerMutex.unlock();
+		return;
+	}
+	
+	Heartbeat& hb = it->second;
+	hb.inFlight = false;
+	if (success) {
+		// Smoothed RTT and variation as in RFC 6298.
+		NymphRttStats& st = hb.stats;
+		if (st.samples == 0) {
+			st.srtt = rtt;
+			st.jitter = rtt / 2;
+		}
+		else {
+			double delta = (st.srtt > rtt) ? st.srtt - rtt : rtt - st.srtt;
+			st.jitter = 0.75 * st.jitter + 0.25 * delta;
+			st.srtt = 0.875 * st.srtt + 0.125 * rtt;
+		}
+		
+		st.rtt = rtt;
+		st.samples++;
+		st.misses = 0;
+		timerMutex.unlock();
+		return;
+	}
+	
+	hb.stats.misses++;
+	if (hb.stats.misses < hb.maxMisses) {
+		timerMutex.unlock();
+		return;
+	}
+	
+	uint32_t hbInterval = hb.interval;
+	uint32_t hbMaxMisses = hb.maxMisses;
+	heartbeats.erase(it);
+	timerMutex.unlock();
+	
+	NYMPH_LOG_ERROR("Remote missed heartbeats, disconnecting: " + result);
+	if (!resolveHandle(handle, physical)) { return; }
+	
+	statusMutex.lock();
+	statusCache.erase(handle);
+	statusMutex.unlock();
+	
+	// Report the disconnect here, as the NymphRPC disconnect callback for it is ignored.
+	markDropped(physical);
+	NymphRemoteServer::disconnect(physical, result);
+	if (!startReconnect(physical) && disconnectedFunction) {
+		dispatchEvent(std::bind(disconnectedFunction, physical));
+	}
+	
+	// Keep monitoring a managed connection once it has been re-established.
+	if (handle & NYMPH_MANAGED_HANDLE) {
+		enableHeartbeat(handle, hbInterval, hbMaxMisses);
+	}
+}
+
+
+// --- ENABLE HEARTBEAT ---
+/**
+	Periodically check that the remote is alive and measure the round-trip time. If the remote
+	misses the configured number of heartbeats in a row, the disconnect callback is called and 
+	the connection closed. Managed connections are reconnected instead.
+	
+	@param handle 		The handle for the remote server.
+	@param interval		Time between heartbeats in milliseconds. Also used as heartbeat timeout.
+	@param maxMisses	Number of consecutive missed heartbeats before disconnecting.
+	
+	@return True if the operation succeeded.
+*/
+bool NymphCastClient::enableHeartbeat(uint32_t handle, uint32_t interval, uint32_t maxMisses) {
+	if (interval == 0 || maxMisses == 0) { return false; }
+	
+	timerMutex.lock();
+	if (!startTimer()) {
+		timerMutex.unlock();
+		return false;
+	}
+	
+	Heartbeat& hb = heartbeats[handle];
+	hb.interval = interval;
+	hb.maxMisses = maxMisses;
+	hb.next = std::chrono::steady_clock::now();
+	timerMutex.unlock();
+	timerCv.notify_one();
+	
+	return true;
+}
+
+
+// --- DISABLE HEARTBEAT ---
+/**
+	Stop sending heartbeats to the remote.
+	
+	@param handle 	The handle for the remote server.
+*/
+void NymphCastClient::disableHeartbeat(uint32_t handle) {
+	timerMutex.lock();
+	heartbeats.erase(handle);
+	timerMutex.unlock();
+}
+
+
+// --- GET RTT ---
+/**
+	Obtain the round-trip time statistics for a remote with an enabled heartbeat.
+	
+	@param handle 	The handle for the remote server.
+	@param stats	Receives the statistics.
+	
+	@return True if a heartbeat is enabled for the handle.
+*/
+bool NymphCastClient::getRtt(uint32_t handle, NymphRttStats &stats) {
+	timerMutex.lock();
+	std::map<uint32_t, Heartbeat>::const_iterator it = heartbeats.find(handle);
+	if (it == heartbeats.end()) {
+		timerMutex.unlock();
+		return false;
+	}
+	
+	stats = it->second.stats;
+	timerMutex.unlock();
+	
+	return true;
+}
+
+
+// --- PRUNE MEDIA SERVER POOL ---
+// Remove pooled media server connections which have been idle for too long or which were
+// reported as disconnected. The pool mutex must be held by the caller. The returned handles have 
+// to be closed using closeMediaServers() after releasing the mutex. 'next' is set to the time in
+// milliseconds until the next remaining connection expires.
+std::vector<uint32_t> NymphCastClient::pruneMediaServerPool(uint32_t &next) {
+	std::vector<uint32_t> stale;
+	next = msIdleTimeout + 1;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::map<std::string, std::vector<PooledConnection> >::iterator it = msPool.begin();
+	while (it != msPool.end()) {
+		std::vector<PooledConnection>& conns = it->second;
+		for (int i = conns.size() - 1; i >= 0; --i) {
+			uint32_t idle = std::chrono::duration_cast<std::chrono::milliseconds>(
+															now - conns[i].lastUsed).count();
+			if (idle > msIdleTimeout || !msHandles[conns[i].handle]) {
+				msHandles[conns[i].handle] = false;
+				stale.push_back(conns[i].handle);
+				conns.erase(conns.begin() + i);
+			}
+			else if (msIdleTimeout + 1 - idle < next) {
+				next = msIdleTimeout + 1 - idle;
+			}
+		}
+		
+		if (conns.empty()) { it = msPool.erase(it); }
+		else { ++it; }
+	}
+	
+	// Forget closed connections for which no disconnect callback arrived.
+	std::map<uint32_t, std::chrono::steady_clock::time_point>::iterator cit = msClosed.begin();
+	while (cit != msClosed.end()) {
+		if (now - cit->second > std::chrono::milliseconds(msClosedGrace)) {
+			msHandles.erase(cit->first);
+			cit = msClosed.erase(cit);
+		}
+		else { ++cit; }
+	}
+	
+	return stale;
+}
+
+
+// --- EXPIRE MEDIA SERVERS ---
+// Timer task which closes idle pooled media server connections, so that they don't stay open
+// until the next checkout. Reschedules itself for as long as connections remain in the pool.
+void NymphCastClient::expireMediaServers() {
+	uint32_t next;
+	msPoolMutex.lock();
+	std::vector<uint32_t> stale = pruneMediaServerPool(next);
+	msExpiryScheduled = !msPool.empty();
+	bool reschedule = msExpiryScheduled;
+	msPoolMutex.unlock();
+	
+	closeMediaServers(stale);
+	if (reschedule) {
+		scheduleTask(next, std::bind(&NymphCastClient::expireMediaServers, this));
+	}
+}
+
+
+// --- CLOSE MEDIA SERVERS ---
+// Disconnect the provided media server connections. They remain registered as dead pool handles
+// until their disconnect callback arrived, so that it isn't reported to the user. Handles for 
+// which no callback arrives are forgotten after msClosedGrace.
+void NymphCastClient::closeMediaServers(std::vector<uint32_t> handles) {
+	if (handles.empty()) { return; }
+	
+	msPoolMutex.lock();
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < handles.size(); ++i) {
+		msHandles[handles[i]] = false;
+		msClosed[handles[i]] = now;
+	}
+	
+	msPoolMutex.unlock();
+	
 	std::string result;
-	if (!NymphRemoteServer::connect(serverip, serverport, handle, 0, result)) {
-		//std::cout << "Connecting to remote server failed: " << result << std::endl;
-		NYMPH_LOG_ERROR("Connecting to remote server failed: " + result);
-		NymphRemoteServer::disconnect(handle, result);
-		return false;
+	for (uint32_t i = 0; i < handles.size(); ++i) {
+		NymphRemoteServer::disconnect(handles[i], result);
 	}
-	
-	// Send message and wait for response.
+}
+
+
+// --- PROBE MEDIA SERVER ---
+// Check whether a pooled media server connection is still alive, using a 'connect' call with a
+// short timeout.
+bool NymphCastClient::probeMediaServer(uint32_t handle) {
 	std::vector<NymphType*> values;
 	values.push_back(new NymphType(&clientId));
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "connect", values, returnValue, result)) {
-		//std::cout << "Error calling remote method: " << result << std::endl;
-		NYMPH_LOG_ERROR("Error calling remote method: " + result);
-		NymphRemoteServer::disconnect(handle, result);
+	std::string result;
+	if (!callRemote(handle, "connect", values, returnValue, result, msProbeTimeout)) {
+		NYMPH_LOG_DEBUG("Pooled media server connection failed the probe: " + result);
 		return false;
 	}
 	
 	delete returnValue;
-	
-	
-	// The remote NymphCast server works in a pull fashion, which means that we have to register
-	// a callback with the server. This callback will be called whenever the server needs more
-	// data from the file which we are streaming.
-	
 	return true;
 }
 
 
-// --- DISCONNECT SERVER ---
-/**
-	Disconnect from the remote server.
-	
-	@param handle The handle for the remote server.
-	
-	@return True if the operation succeeded.
-*/
-bool NymphCastClient::disconnectServer(uint32_t handle) {
-	// TODO: don't shutdown entire remote server.
+// --- CHECKOUT MEDIA SERVER ---
+// Obtain a connection to the media server, reusing an idle pooled connection if available. A 
+// pooled connection which has been idle for longer than msProbeIdle is probed first. If the 
+// probe fails, the connection is closed and the next pooled connection or a new connection is 
+// used instead.
+bool NymphCastClient::checkoutMediaServer(NymphCastRemote &mediaserver, uint32_t &handle, 
+																				bool &reused) {
+	std::string key = mediaserver.ipv4 + ":" + std::to_string(mediaserver.port);
+	uint32_t next;
+	msPoolMutex.lock();
+	std::vector<uint32_t> stale = pruneMediaServerPool(next);
+	std::map<std::string, std::vector<PooledConnection> >::iterator it = msPool.find(key);
+	while (it != msPool.end() && !it->second.empty()) {
+		PooledConnection conn = it->second.back();
+		it->second.pop_back();
+		msPoolMutex.unlock();
+		closeMediaServers(stale);
+		stale.clear();
+		
+		uint32_t idle = std::chrono::duration_cast<std::chrono::milliseconds>(
+									std::chrono::steady_clock::now() - conn.lastUsed).count();
+		if (idle < msProbeIdle || probeMediaServer(conn.handle)) {
+			handle = conn.handle;
+			reused = true;
+			return true;
+		}
+		
+		msPoolMutex.lock();
+		msHandles[conn.handle] = false;
+		stale.push_back(conn.handle);
+		it = msPool.find(key);
+	}
 	
-	// Remove the callbacks.
-	NymphRemoteServer::removeCallback("MediaReadCallback");
-	NymphRemoteServer::removeCallback("MediaStopCallback");
-	NymphRemoteServer::removeCallback("MediaSeekCallback");
+	msPoolMutex.unlock();
+	closeMediaServers(stale);
 	
-	// Send disconnect command.
+	// Establish new connection to mediaserver.
+	reused = false;
 	std::string result;
-	std::vector<NymphType*> values;
-	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "disconnect", values, returnValue, result)) {
-		//std::cout << "Error calling remote method: " << result << std::endl;
-		NYMPH_LOG_ERROR("Error calling remote method: " + result);
-		NymphRemoteServer::disconnect(handle, result);
+	if (!NymphRemoteServer::connect(mediaserver.ipv4, mediaserver.port, handle, 0, result)) {
+		NYMPH_LOG_ERROR("Connecting to remote server failed: " + result);
 		return false;
 	}
 	
-	delete returnValue;
-	
-	// Shutdown.
-	NymphRemoteServer::disconnect(handle, result);
+	msPoolMutex.lock();
+	msHandles[handle] = true;
+	msPoolMutex.unlock();
 	
 	return true;
 }
 
 
+// --- RELEASE MEDIA SERVER ---
+// Return a media server connection to the pool, or close it if the last call on it failed.
+void NymphCastClient::releaseMediaServer(NymphCastRemote &mediaserver, uint32_t handle, bool ok) {
+	std::string key = mediaserver.ipv4 + ":" + std::to_string(mediaserver.port);
+	msPoolMutex.lock();
+	if (!ok || !msHandles[handle]) {
+		msHandles[handle] = false;
+		msPoolMutex.unlock();
+		closeMediaServers(std::vector<uint32_t>(1, handle));
+		return;
+	}
+	
+	PooledConnection conn;
+	conn.handle = handle;
+	conn.lastUsed = std::chrono::steady_clock::now();
+	msPool[key].push_back(conn);
+	bool schedule = !msExpiryScheduled;
+	msExpiryScheduled = true;
+	uint32_t delay = msIdleTimeout + 1;
+	msPoolMutex.unlock();
+	
+	if (schedule) {
+		scheduleTask(delay, std::bind(&NymphCastClient::expireMediaServers, this));
+	}
+}
+
+
+// --- CALL MEDIA SERVER ---
+// Call a method on the media server using a pooled connection. If the call fails on a reused 
+// connection and the method is idempotent, the call is retried once on a fresh connection. Other
+// methods are not retried, as the failed call may still have been performed by the server. The 
+// encoder fills in the call parameters for each attempt.
+bool NymphCastClient::callMediaServer(NymphCastRemote &mediaserver, std::string method, 
+									bool idempotent, 
+									std::function<void(std::vector<NymphType*> &)> encoder, 
+									NymphType* &returnValue, long timeout) {
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		uint32_t mshandle;
+		bool reused;
+		if (!checkoutMediaServer(mediaserver, mshandle, reused)) { return false; }
+		
+		std::vector<NymphType*> values;
+		encoder(values);
+		std::string result;
+		if (callRemote(mshandle, method, values, returnValue, result, timeout)) {
+			releaseMediaServer(mediaserver, mshandle, true);
+			return true;
+		}
+		
+		releaseMediaServer(mediaserver, mshandle, false);
+		if (!reused || !idempotent) {
+			NYMPH_LOG_ERROR("Error calling remote method " + method + ": " + result);
+			return false;
+		}
+		
+		NYMPH_LOG_DEBUG("Pooled media server connection failed, retrying: " + result);
+	}
+	
+	return false;
+}
+
+
+// --- SET MEDIA SERVER IDLE TIMEOUT ---
+/**
+	Set the time after which an idle pooled connection to a media server is closed.
+	
+	@param timeout	Idle timeout in milliseconds.
+*/
+void NymphCastClient::setMediaServerIdleTimeout(uint32_t timeout) {
+	msPoolMutex.lock();
+	msIdleTimeout = timeout;
+	msPoolMutex.unlock();
+}
+
+
 // --- GET SHARES ---
 /**
 	Attempt to obtain the list of shared media files from a NymphCast Media Server.
 	
 	@param mediaserver	Information on the target media server instance.
+	@param timeout		Timeout for the call in milliseconds. 0 to use the configured timeout.
 	
 	@return Vector with the list of available files, if successful.
 */
-std::vector<NymphMediaFile> NymphCastClient::getShares(NymphCastRemote mediaserver) {
+std::vector<NymphMediaFile> NymphCastClient::getShares(NymphCastRemote mediaserver, long timeout) {
 	std::vector<NymphMediaFile> files;
 	
-	// Establish new connection to mediaserver.
-	uint32_t mshandle;
-	std::string result;
-	if (!NymphRemoteServer::connect(mediaserver.ipv4, mediaserver.port, mshandle, 0, result)) {
-		//std::cout << "Connecting to remote server failed: " << result << std::endl;
-		NYMPH_LOG_ERROR("Connecting to remote server failed: " + result);
-		return files;
-	}
-	
 	// Call RPC function to get the list of shared files on the server.
-	std::vector<NymphType*> values;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(mshandle, "getFileList", values, returnValue, result)) {
-		std::cout << "Error calling remote method getFileList: " << result << std::endl;
+	if (!callMediaServer(mediaserver, "getFileList", true, 
+							[](std::vector<NymphType*> &values) { }, returnValue, timeout)) {
 		return files;
 	}
 	
-	// Disconnect from remote mediaserver.
-	NymphRemoteServer::disconnect(mshandle, result);
-	
 	// Parse array and return it. If parse error, return the list up till that point.
 	std::vector<NymphType*>* ncf = returnValue->getArray();
 	for (int j = 0; j < ncf->size(); ++j) {
 		NymphMediaFile file;
 		file.mediaserver = mediaserver;
 		NymphType* value = 0;
-		if (!(*ncf)[j]->getStructValue("id", value)) { return files; }
+		if (!(*ncf)[j]->getStructValue("id", value)) { break; }
 		file.id = value->getUint32();
-		if (!(*ncf)[j]->getStructValue("filename", value)) { return files; }
+		if (!(*ncf)[j]->getStructValue("filename", value)) { break; }
 		file.name = value->getString();
-		if (!(*ncf)[j]->getStructValue("section", value)) { return files; }
+		if (!(*ncf)[j]->getStructValue("section", value)) { break; }
 		file.section = value->getString();
-		if (!(*ncf)[j]->getStructValue("rel_path", value)) { return files; }
+		if (!(*ncf)[j]->getStructValue("rel_path", value)) { break; }
 		file.rel_path = value->getString();
-		if (!(*ncf)[j]->getStructValue("type", value)) { return files; }
+		if (!(*ncf)[j]->getStructValue("type", value)) { break; }
 		file.type = (NymphMediaFileType) value->getUint8();
 		
 		files.push_back(file);
@@ -796,56 +2755,44 @@ uint8_t NymphCastClient::playShare(NymphMediaFile file, std::vector<NymphCastRem
 	uint8_t res = 2;
 	if (receivers.empty()) { return res; }
 	
-	// Establish new connection to mediaserver.
-	uint32_t mshandle;
-	std::string result;
-	if (!NymphRemoteServer::connect(file.mediaserver.ipv4, file.mediaserver.port, mshandle, 0, result)) {
-		std::cout << "Connecting to remote server failed: " << result << std::endl;
-		return res;
-	}
-	
-	// Encode receivers.
-	std::vector<NymphType*>* recArr = new std::vector<NymphType*>();
-	for (int i = 0; i < receivers.size(); ++i) {
-		std::map<std::string, NymphPair>* pairs = new std::map<std::string, NymphPair>();
-		NymphPair pair;
-		std::string* key;
-		key = new std::string("name");
-		pair.key = new NymphType(key, true);
-		pair.value = new NymphType(&receivers[i].name);
-		pairs->insert(std::pair<std::string, NymphPair>(*key, pair));
-		
-		key = new std::string("ipv4");
-		pair.key = new NymphType(key, true);
-		pair.value = new NymphType(&receivers[i].ipv4);
-		pairs->insert(std::pair<std::string, NymphPair>(*key, pair));
-		
-		key = new std::string("ipv6");
-		pair.key = new NymphType(key, true);
-		pair.value = new NymphType(&receivers[i].ipv6);
-		pairs->insert(std::pair<std::string, NymphPair>(*key, pair));
+	// Encoder for the file data and receivers.
+	auto encoder = [&file, &receivers](std::vector<NymphType*> &values) {
+		// Encode receivers.
+		std::vector<NymphType*>* recArr = new std::vector<NymphType*>();
+		for (int i = 0; i < receivers.size(); ++i) {
+			std::map<std::string, NymphPair>* pairs = new std::map<std::string, NymphPair>();
+			NymphPair pair;
+			std::string* key;
+			key = new std::string("name");
+			pair.key = new NymphType(key, true);
+			pair.value = new NymphType(&receivers[i].name);
+			pairs->insert(std::pair<std::string, NymphPair>(*key, pair));
+			
+			key = new std::string("ipv4");
+			pair.key = new NymphType(key, true);
+			pair.value = new NymphType(&receivers[i].ipv4);
+			pairs->insert(std::pair<std::string, NymphPair>(*key, pair));
+			
+			key = new std::string("ipv6");
+			pair.key = new NymphType(key, true);
+			pair.value = new NymphType(&receivers[i].ipv6);
+			pairs->insert(std::pair<std::string, NymphPair>(*key, pair));
+			
+			recArr->push_back(new NymphType(pairs, true));
+		}
 		
-		recArr->push_back(new NymphType(pairs, true));
-	}
-	
-	// Encode file data.
-	NymphType* fileId = new NymphType(file.id);
-	NymphType* filename = new NymphType(&file.name);
+		// Encode file data.
+		values.push_back(new NymphType(file.id));
+		values.push_back(new NymphType(&file.name));
+		values.push_back(new NymphType(recArr, true));
+	};
 	
-	// Call RPC function to get the list of shared files on the server.
-	std::vector<NymphType*> values;
-	values.push_back(fileId);
-	values.push_back(filename);
-	values.push_back(new NymphType(recArr, true));
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(mshandle, "playMedia", values, returnValue, result)) {
-		std::cout << "Error calling remote method playMedia: " << result << std::endl;
+	// Starting playback is not idempotent, so a failed call is not retried.
+	if (!callMediaServer(file.mediaserver, "playMedia", false, encoder, returnValue)) {
 		return res;
 	}
 	
-	// Disconnect from remote mediaserver.
-	NymphRemoteServer::disconnect(mshandle, result);
-	
 	// Check result.
 	res = returnValue->getUint8();	
 	delete returnValue;
@@ -859,17 +2806,18 @@ uint8_t NymphCastClient::playShare(NymphMediaFile file, std::vector<NymphCastRem
 	Attempt to obtain the list of shared media files from a NymphCast Server.
 	
 	@param receiver	Handle of the target server instance.
+	@param timeout	Timeout for the call in milliseconds. 0 to use the configured timeout.
 	
 	@return Vector with the list of available files, if successful.
 */
-std::vector<NymphMediaFile> NymphCastClient::getReceiverShares(uint32_t handle) {
+std::vector<NymphMediaFile> NymphCastClient::getReceiverShares(uint32_t handle, long timeout) {
 	std::vector<NymphMediaFile> files;
 	
 	// Call RPC function to get the list of shared files on the server.
 	std::string result;
 	std::vector<NymphType*> values;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "getFileList", values, returnValue, result)) {
+	if (!callRemote(handle, "getFileList", values, returnValue, result, timeout)) {
 		std::cout << "Error calling remote method getFileList: " << result << std::endl;
 		return files;
 	}
@@ -918,7 +2866,7 @@ bool NymphCastClient::playReceiverShare(uint32_t handle, NymphMediaFile file) {
 	values.push_back(fileId);
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "playMedia", values, returnValue, result)) {
+	if (!callRemote(handle, "playMedia", values, returnValue, result)) {
 		std::cout << "Error calling remote method playMedia: " << result << std::endl;
 		return false;
 	}
@@ -944,6 +2892,20 @@ bool NymphCastClient::playReceiverShare(uint32_t handle, NymphMediaFile file) {
 	@return True if the operation succeeded.
 */
 bool NymphCastClient::addSlaves(uint32_t handle, std::vector<NymphCastRemote> remotes) {
+	// Remember the slaves of a managed connection, to restore them after a reconnect.
+	if (handle & NYMPH_MANAGED_HANDLE) {
+		managedMutex.lock();
+		std::map<uint32_t, ManagedConnection>::iterator it = managed.find(handle);
+		if (it != managed.end()) { it->second.slaves = remotes; }
+		managedMutex.unlock();
+	}
+	
+	return sendSlaves(handle, remotes);
+}
+
+
+// --- SEND SLAVES ---
+bool NymphCastClient::sendSlaves(uint32_t handle, std::vector<NymphCastRemote> &remotes) {
 	std::vector<NymphType*>* sArr = new std::vector<NymphType*>();
 	for (int i = 0; i < remotes.size(); ++i) {
 		std::map<std::string, NymphPair>* remote = new std::map<std::string, NymphPair>;
@@ -970,7 +2932,7 @@ bool NymphCastClient::addSlaves(uint32_t handle, std::vector<NymphCastRemote> re
 	std::string result;
 	NymphType* returnValue = 0;
 	values.push_back(new NymphType(sArr, true));
-	if (!NymphRemoteServer::callMethod(handle, "session_add_slave", values, returnValue, result)) {
+	if (!callRemote(handle, "session_add_slave", values, returnValue, result)) {
 		std::cout << "Error calling remote method session_add_slave: " << result << std::endl;
 		return false;
 	}
@@ -1048,9 +3010,9 @@ bool NymphCastClient::castFile(uint32_t handle, std::string filename) {
 	
 	values.clear();
 	values.push_back(new NymphType(pairs, true));
-	if (!NymphRemoteServer::callMethod(handle, "session_start", values, returnValue, result)) {
+	if (!callRemote(handle, "session_start", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return false;
 	}
 	
@@ -1078,9 +3040,9 @@ bool NymphCastClient::castUrl(uint32_t handle, std::string &url) {
 	std::string result;
 	NymphType* returnValue = 0;
 	values.push_back(new NymphType(&url));
-	if (!NymphRemoteServer::callMethod(handle, "playback_url", values, returnValue, result)) {
+	if (!callRemote(handle, "playback_url", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return false;
 	}
 	
@@ -1108,9 +3070,9 @@ uint8_t NymphCastClient::volumeSet(uint32_t handle, uint8_t volume) {
 	std::string result;
 	NymphType* returnValue = 0;
 	values.push_back(new NymphType(volume));
-	if (!NymphRemoteServer::callMethod(handle, "volume_set", values, returnValue, result)) {
+	if (!callRemote(handle, "volume_set", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1135,9 +3097,9 @@ uint8_t NymphCastClient::volumeUp(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "volume_up", values, returnValue, result)) {
+	if (!callRemote(handle, "volume_up", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1162,9 +3124,9 @@ uint8_t NymphCastClient::volumeDown(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "volume_down", values, returnValue, result)) {
+	if (!callRemote(handle, "volume_down", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1189,9 +3151,9 @@ uint8_t NymphCastClient::volumeMute(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "volume_mute", values, returnValue, result)) {
+	if (!callRemote(handle, "volume_mute", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1216,9 +3178,9 @@ uint8_t NymphCastClient::playbackStart(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "playback_start", values, returnValue, result)) {
+	if (!callRemote(handle, "playback_start", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1243,9 +3205,9 @@ uint8_t NymphCastClient::playbackStop(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "playback_stop", values, returnValue, result)) {
+	if (!callRemote(handle, "playback_stop", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1270,9 +3232,9 @@ uint8_t NymphCastClient::playbackPause(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "playback_pause", values, returnValue, result)) {
+	if (!callRemote(handle, "playback_pause", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1297,9 +3259,9 @@ uint8_t NymphCastClient::playbackRewind(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "playback_rewind", values, returnValue, result)) {
+	if (!callRemote(handle, "playback_rewind", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1324,9 +3286,9 @@ uint8_t NymphCastClient::playbackForward(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "playback_forward", values, returnValue, result)) {
+	if (!callRemote(handle, "playback_forward", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1359,16 +3321,15 @@ uint8_t NymphCastClient::playbackSeek(uint32_t handle, NymphSeekType type, uint6
 		valArray->push_back(new NymphType((uint8_t) value));
 	}
 	else {
-		std::vector<NymphType*>* valArray = new std::vector<NymphType*>();
 		valArray->push_back(new NymphType((uint8_t) NYMPH_SEEK_TYPE_BYTES));
 		valArray->push_back(new NymphType((uint64_t) value));
 	}
 	
 	values.push_back(new NymphType(valArray, true));
 	
-	if (!NymphRemoteServer::callMethod(handle, "playback_seek", values, returnValue, result)) {
+	if (!callRemote(handle, "playback_seek", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 1;
 	}
 	
@@ -1380,95 +3341,398 @@ uint8_t NymphCastClient::playbackSeek(uint32_t handle, NymphSeekType type, uint6
 }
 
 
+// Command types for coalesced commands.
+enum {
+	COALESCE_VOLUME_SET = 1,
+	COALESCE_PLAYBACK_SEEK = 2
+};
+
+
+// --- COALESCE COMMAND ---
+// Store the latest target value for a handle & command type. If no call for this pair is in
+// flight, a task is started which sends it. Otherwise the running task picks it up once the
+// current call completes, dropping any intermediate values.
+void NymphCastClient::coalesceCommand(uint32_t handle, uint8_t command, NymphSeekType type, 
+																			uint64_t value) {
+	uint64_t key = ((uint64_t) handle << 8) | command;
+	coalescedMutex.lock();
+	CoalescedCommand& cmd = coalesced[key];
+	cmd.pending = true;
+	cmd.seekType = type;
+	cmd.value = value;
+	if (cmd.inFlight) {
+		coalescedMutex.unlock();
+		return;
+	}
+	
+	cmd.inFlight = true;
+	coalescedMutex.unlock();
+	
+	runTask(std::bind(&NymphCastClient::coalescedSender, this, handle, command));
+}
+
+
+// --- COALESCED SENDER ---
+// Sends the pending value for the handle & command type until no new value has been set.
+void NymphCastClient::coalescedSender(uint32_t handle, uint8_t command) {
+	uint64_t key = ((uint64_t) handle << 8) | command;
+	while (true) {
+		coalescedMutex.lock();
+		CoalescedCommand& cmd = coalesced[key];
+		if (!cmd.pending) {
+			coalesced.erase(key);
+			coalescedMutex.unlock();
+			return;
+		}
+		
+		cmd.pending = false;
+		NymphSeekType type = cmd.seekType;
+		uint64_t value = cmd.value;
+		coalescedMutex.unlock();
+		
+		if (command == COALESCE_VOLUME_SET) {
+			volumeSet(handle, (uint8_t) value);
+		}
+		else if (command == COALESCE_PLAYBACK_SEEK) {
+			playbackSeek(handle, type, value);
+		}
+	}
+}
+
+
+// --- CANCEL COALESCED ---
+/**
+	Drop any coalesced commands for the remote which have not been sent yet. A call which is
+	already in progress is not affected.
+	
+	@param handle 	The handle for the remote server.
+*/
+void NymphCastClient::cancelCoalesced(uint32_t handle) {
+	coalescedMutex.lock();
+	std::map<uint64_t, CoalescedCommand>::iterator it;
+	for (it = coalesced.begin(); it != coalesced.end(); ++it) {
+		if ((it->first >> 8) == handle) { it->second.pending = false; }
+	}
+	
+	coalescedMutex.unlock();
+}
+
+
+// --- VOLUME SET COALESCED ---
+/**
+	Set the volume on the target remote without blocking. Rapid calls for the same remote are
+	coalesced: only the most recent volume is sent once the previous call has completed.
+	
+	@param handle 	The handle for the remote server.
+	@param volume	Target volume level.
+*/
+void NymphCastClient::volumeSetCoalesced(uint32_t handle, uint8_t volume) {
+	coalesceCommand(handle, COALESCE_VOLUME_SET, NYMPH_SEEK_TYPE_BYTES, volume);
+}
+
+
+// --- PLAYBACK SEEK COALESCED ---
+/**
+	Seek on the target remote without blocking. Rapid calls for the same remote are coalesced:
+	only the most recent seek target is sent once the previous call has completed.
+	
+	@param handle 	The handle for the remote server.
+	@param type		Seek type (bytes or percentage).
+	@param value	Seek target.
+*/
+void NymphCastClient::playbackSeekCoalesced(uint32_t handle, NymphSeekType type, uint64_t value) {
+	coalesceCommand(handle, COALESCE_PLAYBACK_SEEK, type, value);
+}
+
+
 // --- PLAYBACK STATUS ---
 /**
 	Request the playback status from the remote.
 	
 	@param handle 	The handle for the remote server.
+	@param timeout	Timeout for the call in milliseconds. 0 to use the configured timeout.
 	
 	@return A NymphPlaybackStatus struct with playback information.
 */
-NymphPlaybackStatus NymphCastClient::playbackStatus(uint32_t handle) {
+NymphPlaybackStatus NymphCastClient::playbackStatus(uint32_t handle, long timeout) {
 	NymphPlaybackStatus stat;
 	stat.error = true;
 	
-	std::vector<NymphType*> values;
 	std::string result;
-	NymphType* nstruct = 0;
-	if (!NymphRemoteServer::callMethod(handle, "playback_status", values, nstruct, result)) {
+	if (!fetchStatus(handle, stat, timeout, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return stat;
 	}
 	
-	NymphType* splay;
-	if (!nstruct->getStructValue("playing", splay)) {
-		std::cerr << "Failed to find value 'playing' in struct." << std::endl;
-		return stat;
+	return stat;
+}
+
+
+// --- FETCH STATUS ---
+// Request the playback status from the remote and update the status cache with it. Returns
+// false if the call failed. A status struct which fails to decode is returned with its error 
+// flag set.
+bool NymphCastClient::fetchStatus(uint32_t handle, NymphPlaybackStatus &stat, long timeout, 
+																		std::string &result) {
+	std::vector<NymphType*> values;
+	NymphType* nstruct = 0;
+	if (!callRemote(handle, "playback_status", values, nstruct, result, timeout)) {
+		return false;
 	}
 	
-	stat.error = false;
-	stat.playing = splay->getBool();
-	NymphType* status;
-	NymphType* duration;
-	NymphType* position;
-	NymphType* volume;
-	NymphType* artist;
-	NymphType* title;
-	NymphType* stopped;
-	NymphType* subdis;
-	if (!nstruct->getStructValue("status", status)) {
-		std::cerr << "Failed to find value 'status' in struct." << std::endl;
-		return stat;
+	std::string missing;
+	bool decoded = decodeStatus(nstruct, stat, missing);
+	delete nstruct;
+	if (!decoded) {
+		std::cerr << "Failed to find value '" << missing << "' in struct." << std::endl;
+		stat.error = true;
+		return true;
 	}
 	
-	if (!nstruct->getStructValue("duration", duration)) {
-		std::cerr << "Failed to find value 'duration' in struct." << std::endl;
-		return stat;
-	}
+	updateStatusCache(handle, stat);
 	
-	if (!nstruct->getStructValue("position", position)) {
-		std::cerr << "Failed to find value 'position' in struct." << std::endl;
-		return stat;
-	}
+	return true;
+}
+
+
+// Shared state for a playbackStatusAll() batch. Workers may outlive the call if the deadline
+// expires while a status request is in progress.
+struct StatusBatch {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::vector<NymphStatusResult> results;
+	std::chrono::steady_clock::time_point end;
+	uint32_t next = 0;
+	uint32_t active = 0;
+	bool expired = false;
+};
+
+
+// --- PLAYBACK STATUS ALL ---
+/**
+	Request the playback status from multiple remotes concurrently.
 	
-	if (!nstruct->getStructValue("volume", volume)) {
-		std::cerr << "Failed to find value 'volume' in struct." << std::endl;
-		return stat;
-	}
+	Remotes which did not respond before the deadline are returned as stale, with the cached 
+	status for the remote if one is available. A failed request does not disconnect the remote.
 	
-	if (!nstruct->getStructValue("artist", artist)) {
-		std::cerr << "Failed to find value 'artist' in struct." << std::endl;
-		return stat;
+	@param handles 		The handles for the remote servers.
+	@param deadline		Time in milliseconds after which the call returns.
+	@param maxInFlight	Maximum number of simultaneous status requests. Capped at half the task 
+						pool, as each request with a deadline also uses a task pool thread.
+	
+	@param cancel		Optional flag which cancels the remaining requests when set.
+	
+	@return Vector with a result for each handle, in the same order as the provided handles.
+*/
+std::vector<NymphStatusResult> NymphCastClient::playbackStatusAll(std::vector<uint32_t> handles,
+							uint32_t deadline, uint32_t maxInFlight, NymphCancelFlag cancel) {
+	std::shared_ptr<StatusBatch> batch = std::make_shared<StatusBatch>();
+	batch->results.resize(handles.size());
+	for (uint32_t i = 0; i < handles.size(); ++i) {
+		batch->results[i].handle = handles[i];
+		batch->results[i].status.error = true;
+	}
+	
+	batch->end = std::chrono::steady_clock::now() + std::chrono::milliseconds(deadline);
+	
+	uint32_t workers = maxInFlight;
+	if (workers > tasksMax / 2) { workers = tasksMax / 2; }
+	if (workers == 0) { workers = 1; }
+	if (workers > handles.size()) { workers = handles.size(); }
+	
+	// Each worker keeps taking the next handle until none are left, the deadline expired or the
+	// batch got cancelled. The remaining time until the deadline is used as the call timeout.
+	auto worker = [this, batch, cancel]() {
+		std::unique_lock<std::mutex> lock(batch->mutex);
+		while (!batch->expired && !(cancel && *cancel) && batch->next < batch->results.size()) {
+			uint32_t idx = batch->next++;
+			uint32_t handle = batch->results[idx].handle;
+			long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+								batch->end - std::chrono::steady_clock::now()).count();
+			lock.unlock();
+			
+			NymphPlaybackStatus stat;
+			stat.error = true;
+			std::string result;
+			bool received = (remaining > 0) && fetchStatus(handle, stat, remaining, result);
+			
+			lock.lock();
+			if (batch->expired || !received) { continue; }
+			
+			batch->results[idx].status = stat;
+			batch->results[idx].stale = false;
+			batch->results[idx].age = 0;
+		}
+		
+		batch->active--;
+		batch->cv.notify_all();
+	};
+	
+	batch->active = workers;
+	for (uint32_t i = 0; i < workers; ++i) {
+		if (!runTask(worker)) {
+			std::unique_lock<std::mutex> lock(batch->mutex);
+			batch->active--;
+		}
 	}
 	
-	if (!nstruct->getStructValue("title", title)) {
-		std::cerr << "Failed to find value 'title' in struct." << std::endl;
-		return stat;
+	// Wait for all workers to finish, or the deadline to expire. The cancel flag is checked 
+	// every 50 ms.
+	std::unique_lock<std::mutex> lock(batch->mutex);
+	while (batch->active > 0 && std::chrono::steady_clock::now() < batch->end) {
+		if (cancel && *cancel) { break; }
+		
+		std::chrono::steady_clock::time_point slice = std::chrono::steady_clock::now() + 
+															std::chrono::milliseconds(50);
+		batch->cv.wait_until(lock, (slice < batch->end) ? slice : batch->end);
+	}
+	
+	batch->expired = true;
+	std::vector<NymphStatusResult> results = batch->results;
+	lock.unlock();
+	
+	// Fill in the cached status for the remotes which did not respond in time.
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	statusMutex.lock();
+	for (uint32_t i = 0; i < results.size(); ++i) {
+		if (!results[i].stale) { continue; }
+		std::map<uint32_t, CachedStatus>::const_iterator it = statusCache.find(results[i].handle);
+		if (it == statusCache.end()) { continue; }
+		
+		results[i].status = it->second.status;
+		results[i].cached = true;
+		results[i].age = std::chrono::duration_cast<std::chrono::milliseconds>(
+												now - it->second.updated).count();
 	}
 	
-	if (!nstruct->getStructValue("stopped", stopped)) {
-		std::cerr << "MediaStatusCallback: Failed to find value 'stopped' in struct." << std::endl;
-		return stat;
+	statusMutex.unlock();
+	
+	return results;
+}
+
+
+// --- UPDATE STATUS CACHE ---
+// Store the latest status received for a remote. Returns a bitmask of NymphStatusField values
+// for the fields which differ from the previously cached status. The title and artist strings
+// are only copied into the cache if they changed.
+uint32_t NymphCastClient::updateStatusCache(uint32_t handle, NymphPlaybackStatus &stat) {
+	uint32_t changed = 0;
+	statusMutex.lock();
+	std::map<uint32_t, CachedStatus>::iterator it = statusCache.find(handle);
+	if (it == statusCache.end()) {
+		CachedStatus& cs = statusCache[handle];
+		cs.status = stat;
+		cs.updated = std::chrono::steady_clock::now();
+		statusMutex.unlock();
+		return NYMPH_STATUS_FIELD_ALL;
+	}
+	
+	// Estimate the remote's playback rate against the local clock from consecutive updates 
+	// during playback, for position interpolation. Updates after a seek or pause are skipped.
+	NymphPlaybackStatus& old = it->second.status;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - it->second.updated).count();
+	if (old.playing && stat.playing && elapsed > 0.5) {
+		double observed = (stat.position - old.position) / elapsed;
+		if (observed > 0.5 && observed < 1.5) {
+			double rate = 0.9 * it->second.rate + 0.1 * observed;
+			if (rate < 0.95) { rate = 0.95; }
+			else if (rate > 1.05) { rate = 1.05; }
+			it->second.rate = rate;
+		}
 	}
 	
-	if (!nstruct->getStructValue("subtitle_disable", subdis)) {
-		std::cerr << "MediaStatusCallback: Failed to find value 'subtitle_disable' in struct." << std::endl;
-		return stat;
+	if (old.status != stat.status) { changed |= NYMPH_STATUS_FIELD_STATUS; }
+	if (old.error != stat.error) { changed |= NYMPH_STATUS_FIELD_ERROR; }
+	if (old.stopped != stat.stopped) { changed |= NYMPH_STATUS_FIELD_STOPPED; }
+	if (old.playing != stat.playing) { changed |= NYMPH_STATUS_FIELD_PLAYING; }
+	if (old.duration != stat.duration) { changed |= NYMPH_STATUS_FIELD_DURATION; }
+	if (old.position != stat.position) { changed |= NYMPH_STATUS_FIELD_POSITION; }
+	if (old.volume != stat.volume) { changed |= NYMPH_STATUS_FIELD_VOLUME; }
+	if (old.subtitles_off != stat.subtitles_off) { changed |= NYMPH_STATUS_FIELD_SUBTITLES; }
+	if (old.title != stat.title) { changed |= NYMPH_STATUS_FIELD_TITLE; }
+	if (old.artist != stat.artist) { changed |= NYMPH_STATUS_FIELD_ARTIST; }
+	
+	old.status = stat.status;
+	old.error = stat.error;
+	old.stopped = stat.stopped;
+	old.playing = stat.playing;
+	old.duration = stat.duration;
+	old.position = stat.position;
+	old.volume = stat.volume;
+	old.subtitles_off = stat.subtitles_off;
+	if (changed & NYMPH_STATUS_FIELD_TITLE) { old.title = stat.title; }
+	if (changed & NYMPH_STATUS_FIELD_ARTIST) { old.artist = stat.artist; }
+	it->second.updated = now;
+	statusMutex.unlock();
+	
+	return changed;
+}
+
+
+// --- GET CACHED STATUS ---
+/**
+	Obtain the playback status of the remote from the status cache. The cache is kept up to date
+	by the status updates the remote pushes and by playbackStatus() calls. Only if the cached
+	status is older than the provided maximum age, it is requested from the remote.
+	
+	@param handle 	The handle for the remote server.
+	@param maxAge	Maximum age of the cached status in milliseconds.
+	
+	@return A NymphPlaybackStatus struct with playback information.
+*/
+NymphPlaybackStatus NymphCastClient::getCachedStatus(uint32_t handle, uint32_t maxAge) {
+	statusMutex.lock();
+	std::map<uint32_t, CachedStatus>::const_iterator it = statusCache.find(handle);
+	if (it != statusCache.end()) {
+		uint64_t age = std::chrono::duration_cast<std::chrono::milliseconds>(
+									std::chrono::steady_clock::now() - it->second.updated).count();
+		if (age <= maxAge) {
+			NymphPlaybackStatus stat = it->second.status;
+			statusMutex.unlock();
+			return stat;
+		}
 	}
 	
-	stat.status = (NymphRemoteStatus) status->getUint32();
-	stat.duration = duration->getUint64();
-	stat.position = position->getDouble();
-	stat.volume = volume->getUint8();
-	stat.artist = artist->getString();
-	stat.title = title->getString();
-	stat.stopped = stopped->getBool();
-	stat.subtitles_off = subdis->getBool();
+	statusMutex.unlock();
 	
-	delete nstruct;
+	return playbackStatus(handle);
+}
+
+
+// --- ESTIMATED POSITION ---
+/**
+	Estimate the current playback position of the remote without contacting it. The position is
+	extrapolated from the last received status using the time since that status was received,
+	corrected for the measured drift between the remote's and the local clock.
 	
-	return stat;
+	@param handle 	The handle for the remote server.
+	
+	@return The estimated position, or -1.0 if no status has been received for this remote.
+*/
+double NymphCastClient::estimatedPosition(uint32_t handle) {
+	statusMutex.lock();
+	std::map<uint32_t, CachedStatus>::const_iterator it = statusCache.find(handle);
+	if (it == statusCache.end() || it->second.status.error) {
+		statusMutex.unlock();
+		return -1.0;
+	}
+	
+	const CachedStatus& cs = it->second;
+	double position = cs.status.position;
+	if (cs.status.playing) {
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - 
+																		cs.updated).count();
+		position += elapsed * cs.rate;
+		if (cs.status.duration > 0 && position > cs.status.duration) {
+			position = cs.status.duration;
+		}
+	}
+	
+	statusMutex.unlock();
+	
+	return position;
 }
 
 
@@ -1479,9 +3743,9 @@ uint8_t NymphCastClient::cycleSubtitles(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "cycle_subtitle", values, returnValue, result)) {
+	if (!callRemote(handle, "cycle_subtitle", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1500,9 +3764,9 @@ uint8_t NymphCastClient::cycleAudio(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "cycle_audio", values, returnValue, result)) {
+	if (!callRemote(handle, "cycle_audio", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1521,9 +3785,9 @@ uint8_t NymphCastClient::cycleVideo(uint32_t handle) {
 	std::vector<NymphType*> values;
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "cycle_video", values, returnValue, result)) {
+	if (!callRemote(handle, "cycle_video", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
@@ -1543,9 +3807,9 @@ uint8_t NymphCastClient::enableSubtitles(uint32_t handle, bool state) {
 	values.push_back(new NymphType(state));
 	std::string result;
 	NymphType* returnValue = 0;
-	if (!NymphRemoteServer::callMethod(handle, "subtitles_set", values, returnValue, result)) {
+	if (!callRemote(handle, "subtitles_set", values, returnValue, result)) {
 		std::cout << "Error calling remote method: " << result << std::endl;
-		NymphRemoteServer::disconnect(handle, result);
+		dropRemote(handle);
 		return 0;
 	}
 	
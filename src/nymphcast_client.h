@@ -18,9 +18,20 @@
 #include <fstream>
 #include <functional>
 #include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <memory>
 
 #include <nymph/nymph.h>
 
+#include <Poco/Net/DatagramSocket.h>
+
 
 struct NymphCastRemote {
 	std::string name;
@@ -51,6 +62,22 @@ struct NymphPlaybackStatus {
 };
 
 
+// Bitmask values for the fields of NymphPlaybackStatus which changed in a status update.
+enum NymphStatusField {
+	NYMPH_STATUS_FIELD_STATUS		= 0x0001,
+	NYMPH_STATUS_FIELD_ERROR		= 0x0002,
+	NYMPH_STATUS_FIELD_STOPPED		= 0x0004,
+	NYMPH_STATUS_FIELD_PLAYING		= 0x0008,
+	NYMPH_STATUS_FIELD_DURATION		= 0x0010,
+	NYMPH_STATUS_FIELD_POSITION		= 0x0020,
+	NYMPH_STATUS_FIELD_VOLUME		= 0x0040,
+	NYMPH_STATUS_FIELD_SUBTITLES	= 0x0080,
+	NYMPH_STATUS_FIELD_TITLE		= 0x0100,
+	NYMPH_STATUS_FIELD_ARTIST		= 0x0200,
+	NYMPH_STATUS_FIELD_ALL			= 0x03FF
+};
+
+
 enum NymphMediaFileType {
 	FILE_TYPE_AUDIO = 0,
 	FILE_TYPE_VIDEO = 1,
@@ -74,9 +101,80 @@ struct NymphMediaFile {
 };
 
 
+struct NymphStatusResult {
+	uint32_t handle = 0;
+	NymphPlaybackStatus status;
+	bool stale = true;		// Remote did not respond before the deadline.
+	bool cached = false;	// Status is the cached status of a stale remote.
+	uint64_t age = 0;		// Age of the status in milliseconds.
+};
+
+
+struct NymphConnectResult {
+	NymphCastRemote remote;
+	uint32_t handle = 0;
+	bool connected = false;
+	std::string error;
+};
+
+
+enum NymphConnectionState {
+	NYMPH_CONNECTION_CONNECTED = 1,
+	NYMPH_CONNECTION_RECONNECTING = 2,
+	NYMPH_CONNECTION_FAILED = 3
+};
+
+
+struct NymphRttStats {
+	double rtt = 0.0;			// Last round-trip time, in milliseconds.
+	double srtt = 0.0;			// Smoothed round-trip time.
+	double jitter = 0.0;		// Round-trip time variation.
+	uint32_t samples = 0;
+	uint32_t misses = 0;		// Consecutive missed heartbeats.
+};
+
+
+// Where callbacks from the network threads are run. Event loop mode takes precedence.
+enum NymphDispatchMode {
+	NYMPH_DISPATCH_DIRECT = 0,		// On the network thread.
+	NYMPH_DISPATCH_THREAD = 1,		// On a dispatcher thread owned by the client.
+	NYMPH_DISPATCH_EXECUTOR = 2		// On a user-provided executor.
+};
+
+
+struct NymphDispatchStats {
+	uint64_t dispatched = 0;	// Events run from the dispatch queue.
+	uint32_t depth = 0;			// Events currently queued.
+	uint32_t maxDepth = 0;
+	double avgLatency = 0.0;	// Time from queueing to running an event, in milliseconds.
+	double maxLatency = 0.0;
+};
+
+
+enum NymphDiscoveryEvent {
+	NYMPH_DISCOVERY_APPEARED = 1,
+	NYMPH_DISCOVERY_DISAPPEARED = 2
+};
+
+
+// Handles returned by connectServerManaged() have this bit set.
+const uint32_t NYMPH_MANAGED_HANDLE = 0x80000000;
+
+
+// Cancellation flag for asynchronous and group calls. Set to true to cancel.
+typedef std::shared_ptr<std::atomic<bool> > NymphCancelFlag;
+
+
 typedef std::function<void(std::string appId, std::string message)> AppMessageFunction;
 typedef std::function<void(uint32_t handle, NymphPlaybackStatus status)> StatusUpdateFunction;
+typedef std::function<void(uint32_t handle, uint32_t changed, 
+							const NymphPlaybackStatus &status)> StatusDeltaFunction;
 typedef std::function<void(uint32_t handle)> RemoteDisconnectFunction;
+typedef std::function<void(uint32_t handle, NymphConnectionState state)> ConnectionStateFunction;
+typedef std::function<void(std::function<void()> task)> NymphExecutorFunction;
+typedef std::function<bool(const NymphCastRemote &remote)> RemoteFoundFunction;
+typedef std::function<void(const NymphCastRemote &remote, bool mediaServer, 
+										NymphDiscoveryEvent event)> RemoteDiscoveryFunction;
 
 // Forward declarations.
 struct NYSD_service;
@@ -93,7 +191,104 @@ class NymphCastClient {
 	
 	AppMessageFunction appMessageFunction;
 	StatusUpdateFunction statusUpdateFunction;
+	StatusDeltaFunction statusDeltaFunction;
 	RemoteDisconnectFunction disconnectedFunction;
+	ConnectionStateFunction connectionStateFunction;
+	
+	// RPC timeouts, in milliseconds.
+	long rpcTimeout;
+	long defaultTimeout;
+	std::map<std::string, long> methodTimeouts;
+	std::map<uint32_t, long> handleTimeouts;
+	std::mutex timeoutsMutex;
+	
+	long resolveTimeout(uint32_t handle, std::string &method, long timeout);
+	bool callRemote(uint32_t handle, std::string method, std::vector<NymphType*> &values, 
+							NymphType* &returnValue, std::string &result, long timeout = 0);
+	
+	// Managed connections, keyed by managed handle.
+	struct ManagedConnection {
+		std::string ip;
+		uint32_t port = 0;
+		uint32_t handle = 0;
+		bool connected = false;
+		std::vector<NymphCastRemote> slaves;
+	};
+	
+	std::map<uint32_t, ManagedConnection> managed;
+	std::map<uint32_t, uint32_t> physicalToManaged;
+	std::set<uint32_t> droppedPhysical;
+	std::mutex managedMutex;
+	std::condition_variable managedCv;
+	bool managedStop = false;
+	uint32_t nextManagedHandle = 0;
+	uint32_t reconnectInitialDelay = 500;
+	uint32_t reconnectMaxDelay = 30000;
+	uint32_t reconnectMaxAttempts = 0;
+	
+	// Heartbeats, keyed by handle.
+	struct Heartbeat {
+		uint32_t interval;
+		uint32_t maxMisses;
+		bool inFlight = false;
+		std::chrono::steady_clock::time_point next;
+		NymphRttStats stats;
+	};
+	
+	// Timer thread, for heartbeats and scheduled tasks.
+	std::map<uint32_t, Heartbeat> heartbeats;
+	std::multimap<std::chrono::steady_clock::time_point, std::function<void()> > timers;
+	std::mutex timerMutex;
+	std::condition_variable timerCv;
+	std::thread timerThread;
+	bool timerRunning = false;
+	bool timerShutdown = false;
+	
+	void timerLoop();
+	bool startTimer();
+	void scheduleTask(uint32_t delay, std::function<void()> task);
+	void sendHeartbeat(uint32_t handle, uint32_t timeout);
+	
+	// Last known playback status, keyed by handle.
+	struct CachedStatus {
+		NymphPlaybackStatus status;
+		std::chrono::steady_clock::time_point updated;
+		double rate = 1.0;		// Remote playback speed relative to the local clock.
+	};
+	
+	std::map<uint32_t, CachedStatus> statusCache;
+	std::mutex statusMutex;
+	
+	uint32_t updateStatusCache(uint32_t handle, NymphPlaybackStatus &stat);
+	
+	// Status subscriptions, keyed by handle.
+	struct StatusSubscription {
+		uint32_t interval = 0;
+		uint32_t fields = NYMPH_STATUS_FIELD_ALL;
+		uint32_t changed = 0;
+		bool flushScheduled = false;
+		std::chrono::steady_clock::time_point lastDelivered;
+	};
+	
+	std::map<uint32_t, StatusSubscription> subscriptions;
+	std::mutex subscriptionsMutex;
+	
+	bool fetchStatus(uint32_t handle, NymphPlaybackStatus &stat, long timeout, std::string &result);
+	bool throttleStatus(uint32_t handle, uint32_t &changed);
+	void flushStatus(uint32_t handle);
+	void deliverStatus(uint32_t handle, uint32_t changed, NymphPlaybackStatus &stat);
+	
+	bool resolveHandle(uint32_t handle, uint32_t &physical);
+	uint32_t userHandle(uint32_t session);
+	void dropRemote(uint32_t handle);
+	void markDropped(uint32_t physical);
+	bool startReconnect(uint32_t session);
+	void reconnectManaged(uint32_t handle);
+	bool closeRemote(uint32_t handle);
+	bool sendSlaves(uint32_t handle, std::vector<NymphCastRemote> &remotes);
+	
+	void registerCallbacks();
+	bool connectRemote(std::string ip, uint32_t port, uint32_t &handle, std::string &result);
 	
 	void MediaReadCallback(uint32_t session, NymphMessage* msg, void* data);
 	void MediaStopCallback(uint32_t session, NymphMessage* msg, void* data);
@@ -102,11 +297,126 @@ class NymphCastClient {
 	void ReceiveFromAppCallback(uint32_t session, NymphMessage* msg, void* data);
 	void DisconnectedCallback(uint32_t session);
 	
+	// Background discovery registry. Index 0 holds receivers, index 1 media servers, keyed by
+	// name and port.
+	struct DiscoveredRemote {
+		NymphCastRemote remote;
+		std::chrono::steady_clock::time_point lastSeen;
+	};
+	
+	std::map<std::string, DiscoveredRemote> discovered[2];
+	std::mutex discoveryMutex;
+	RemoteDiscoveryFunction discoveryFunction;
+	uint32_t discoveryInterval = 5000;
+	uint32_t discoveryTtl = 15000;
+	uint32_t discoveryGeneration = 0;
+	bool discoveryActive = false;
+	bool discoveryReady = false;
+	std::atomic<bool> discoveryMulticast{false};
+	
+	std::vector<NymphCastRemote> queryServers();
+	std::vector<NymphCastRemote> queryShares();
+	std::vector<NymphCastRemote> serverRemotes(std::vector<NYSD_service> &responses);
+	std::vector<NymphCastRemote> shareRemotes(std::vector<NYSD_service> &responses);
+	void runDiscovery(uint32_t generation);
+	bool getDiscovered(bool mediaServers, std::vector<NymphCastRemote> &remotes);
+	
+	// Event loop mode. Events are queued and signalled through a loopback datagram socket pair.
+	std::atomic<bool> eventLoop{false};
+	std::deque<std::function<void()> > events;
+	std::mutex eventsMutex;
+	std::unique_ptr<Poco::Net::DatagramSocket> wakeupReceiver;
+	std::unique_ptr<Poco::Net::DatagramSocket> wakeupSender;
+	
+	void signalEventLoop();
+	void dispatchEvent(std::function<void()> event);
+	NymphCallbackMethod dispatchCallback(NymphCallbackMethod callback);
+	
+	// Dispatch queue. Lock-free multi-producer, single-consumer queue, emptied by either the 
+	// dispatcher thread or a drain task on the user's executor.
+	struct DispatchNode;
+	std::atomic<uint32_t> dispatchMode{NYMPH_DISPATCH_DIRECT};
+	std::atomic<DispatchNode*> dispatchHead;
+	DispatchNode* dispatchTail;
+	std::atomic<bool> dispatchScheduled{false};
+	std::atomic<uint32_t> dispatchProducers{0};
+	NymphExecutorFunction dispatchExecutor;
+	std::thread dispatchThread;
+	std::mutex dispatchMutex;
+	std::condition_variable dispatchCv;
+	bool dispatchSignal = false;
+	bool dispatchRunning = false;
+	
+	std::atomic<uint32_t> dispatchDepth{0};
+	std::atomic<uint32_t> dispatchMaxDepth{0};
+	std::atomic<uint64_t> dispatchCount{0};
+	std::atomic<uint64_t> dispatchLatencyTotal{0};
+	std::atomic<uint64_t> dispatchLatencyMax{0};
+	
+	void queueEvent(std::function<void()> event, uint32_t mode);
+	void signalDispatch(uint32_t mode);
+	void drainDispatch();
+	void dispatchLoop();
+	void stopDispatch();
+	
+	// Background task pool.
+	std::vector<std::thread> taskThreads;
+	std::deque<std::function<void()> > tasks;
+	std::mutex tasksMutex;
+	std::condition_variable tasksCv;
+	uint32_t tasksIdle = 0;
+	uint32_t tasksMax = 32;
+	bool tasksRunning = true;
+	
+	bool runTask(std::function<void()> task);
+	bool taskAvailable();
+	void taskWorker();
+	
+	// Coalesced commands, keyed by handle and command type.
+	struct CoalescedCommand {
+		bool pending = false;
+		bool inFlight = false;
+		NymphSeekType seekType = NYMPH_SEEK_TYPE_BYTES;
+		uint64_t value = 0;
+	};
+	
+	std::map<uint64_t, CoalescedCommand> coalesced;
+	std::mutex coalescedMutex;
+	
+	void coalesceCommand(uint32_t handle, uint8_t command, NymphSeekType type, uint64_t value);
+	void coalescedSender(uint32_t handle, uint8_t command);
+	
+	// Media server connection pool, keyed by 'ip:port'.
+	struct PooledConnection {
+		uint32_t handle;
+		std::chrono::steady_clock::time_point lastUsed;
+	};
+	
+	std::map<std::string, std::vector<PooledConnection> > msPool;
+	std::map<uint32_t, bool> msHandles;
+	std::map<uint32_t, std::chrono::steady_clock::time_point> msClosed;
+	uint32_t msClosedGrace = 60000;
+	std::mutex msPoolMutex;
+	uint32_t msIdleTimeout = 30000;
+	uint32_t msProbeIdle = 1000;
+	long msProbeTimeout = 500;
+	bool msExpiryScheduled = false;
+	
+	bool probeMediaServer(uint32_t handle);
+	bool checkoutMediaServer(NymphCastRemote &mediaserver, uint32_t &handle, bool &reused);
+	void releaseMediaServer(NymphCastRemote &mediaserver, uint32_t handle, bool ok);
+	std::vector<uint32_t> pruneMediaServerPool(uint32_t &next);
+	void expireMediaServers();
+	void closeMediaServers(std::vector<uint32_t> handles);
+	bool callMediaServer(NymphCastRemote &mediaserver, std::string method, bool idempotent, 
+							std::function<void(std::vector<NymphType*> &)> encoder, 
+							NymphType* &returnValue, long timeout = 0);
+	
 	bool isDuplicateName(std::vector<NymphCastRemote> &remotes, NymphCastRemote &rm);
 	void removeLoopback(std::vector<NYSD_service> &responses);
 	
 public:
-	NymphCastClient();
+	NymphCastClient(long timeout = 2000);
 	~NymphCastClient();
 	
 	void setClientId(std::string id);
@@ -114,21 +424,51 @@ public:
 	void setMediaCallbacks(NymphCallbackMethod readcb, NymphCallbackMethod seekcb);
 	void setApplicationCallback(AppMessageFunction function);
 	void setStatusUpdateCallback(StatusUpdateFunction function);
+	void setStatusDeltaCallback(StatusDeltaFunction function);
 	void setDisconnectCallback(RemoteDisconnectFunction function);
+	void setConnectionStateCallback(ConnectionStateFunction function);
+	void setReconnectPolicy(uint32_t initialDelay, uint32_t maxDelay, uint32_t maxAttempts = 0);
+	bool runAsync(std::function<void()> call);
+	bool setEventLoopMode(bool enable);
+	poco_socket_t getPollFd();
+	void postEvent(std::function<void()> event);
+	uint32_t process();
+	bool setDispatchMode(NymphDispatchMode mode, 
+									NymphExecutorFunction executor = NymphExecutorFunction());
+	NymphDispatchStats getDispatchStats();
+	void setDefaultTimeout(long timeout);
+	void setMethodTimeout(std::string method, long timeout);
+	void setHandleTimeout(uint32_t handle, long timeout);
 	std::string getApplicationList(uint32_t handle);
 	std::string sendApplicationMessage(uint32_t handle, std::string &appId, std::string &message, 
 																				uint8_t format = 0);
 	std::string loadResource(uint32_t handle, std::string &appId, std::string &name);
 
 	std::vector<NymphCastRemote> findServers();
+	bool findServers(RemoteFoundFunction function, uint32_t expected = 0, 
+																std::string name = std::string());
 	std::vector<NymphCastRemote> findShares();
+	bool discoverAll(std::vector<NymphCastRemote> &receivers, 
+											std::vector<NymphCastRemote> &mediaServers);
+	void startDiscovery(uint32_t interval = 5000, uint32_t ttl = 15000);
+	void stopDiscovery();
+	void setDiscoveryCallback(RemoteDiscoveryFunction function);
+	void setMulticastDiscovery(bool enable);
 	bool connectServer(std::string ip, uint32_t port, uint32_t &handle);
+	bool connectServerManaged(std::string ip, uint32_t port, uint32_t &handle);
+	std::vector<NymphConnectResult> connectServers(std::vector<NymphCastRemote> remotes, 
+												uint32_t maxInFlight = 8, uint32_t deadline = 5000,
+												NymphCancelFlag cancel = NymphCancelFlag());
 	bool disconnectServer(uint32_t handle);
+	bool enableHeartbeat(uint32_t handle, uint32_t interval = 1000, uint32_t maxMisses = 3);
+	void disableHeartbeat(uint32_t handle);
+	bool getRtt(uint32_t handle, NymphRttStats &stats);
 	
-	std::vector<NymphMediaFile> getShares(NymphCastRemote mediaserver);
+	void setMediaServerIdleTimeout(uint32_t timeout);
+	std::vector<NymphMediaFile> getShares(NymphCastRemote mediaserver, long timeout = 0);
 	uint8_t playShare(NymphMediaFile file, std::vector<NymphCastRemote> receivers);
 	
-	std::vector<NymphMediaFile> getReceiverShares(uint32_t handle);
+	std::vector<NymphMediaFile> getReceiverShares(uint32_t handle, long timeout = 0);
 	bool playReceiverShare(uint32_t handle, NymphMediaFile file);
 	
 	bool addSlaves(uint32_t handle, std::vector<NymphCastRemote> remotes);
@@ -146,7 +486,18 @@ public:
 	uint8_t playbackRewind(uint32_t handle);
 	uint8_t playbackForward(uint32_t handle);
 	uint8_t playbackSeek(uint32_t handle, NymphSeekType type, uint64_t value);
-	NymphPlaybackStatus playbackStatus(uint32_t handle);
+	void volumeSetCoalesced(uint32_t handle, uint8_t volume);
+	void playbackSeekCoalesced(uint32_t handle, NymphSeekType type, uint64_t value);
+	void cancelCoalesced(uint32_t handle);
+	NymphPlaybackStatus playbackStatus(uint32_t handle, long timeout = 0);
+	std::vector<NymphStatusResult> playbackStatusAll(std::vector<uint32_t> handles, 
+											uint32_t deadline = 1000, uint32_t maxInFlight = 8,
+											NymphCancelFlag cancel = NymphCancelFlag());
+	NymphPlaybackStatus getCachedStatus(uint32_t handle, uint32_t maxAge);
+	static bool decodeStatus(NymphType* nstruct, NymphPlaybackStatus &stat, std::string &missing);
+	double estimatedPosition(uint32_t handle);
+	void subscribeStatus(uint32_t handle, double maxRate, uint32_t fields = NYMPH_STATUS_FIELD_ALL);
+	void unsubscribeStatus(uint32_t handle);
 	
 	uint8_t cycleSubtitles(uint32_t handle);
 	uint8_t cycleAudio(uint32_t handle);
@@ -0,0 +1,228 @@
+/*
+	nymphcast_client_coro.h - C++20 coroutine API for the NymphCast client library.
+	
+	Notes:
+			- Optional, header-only. Requires a C++20 compiler with coroutine support.
+			- Calls are performed on the client's task pool (NymphCastClient::runAsync()). The
+			  awaiting coroutine is resumed through the provided executor.
+			- An exception thrown by a call is rethrown in the awaiting coroutine.
+			- Each call takes an optional NymphCancelFlag. A call which did not start yet when the 
+			  flag is set is skipped, and NymphCastCancelled is thrown in the awaiting coroutine.
+*/
+
+
+#ifndef NYMPHCAST_CLIENT_CORO_H
+#define NYMPHCAST_CLIENT_CORO_H
+
+
+#if __cplusplus < 202002L
+#error "nymphcast_client_coro.h requires C++20."
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+#include "nymphcast_client.h"
+
+
+// Thrown in the awaiting coroutine if its call got cancelled before it started.
+class NymphCastCancelled : public std::runtime_error {
+public:
+	NymphCastCancelled() : std::runtime_error("NymphCast call cancelled.") { }
+};
+
+
+// The executor (NymphExecutorFunction) resumes a coroutine once its call has completed. It 
+// receives the resumption function and is expected to run it, e.g. by posting it to an event loop.
+template<typename T>
+class NymphCastAwaitable {
+	NymphCastClient& client;
+	NymphExecutorFunction& executor;
+	std::function<T()> call;
+	NymphCancelFlag cancel;
+	T result;
+	std::exception_ptr error;
+	
+public:
+	NymphCastAwaitable(NymphCastClient& client, NymphExecutorFunction& executor, 
+										std::function<T()> call, NymphCancelFlag cancel) :
+		client(client), executor(executor), call(std::move(call)), cancel(std::move(cancel)), 
+		result() { }
+	
+	bool await_ready() const noexcept { return false; }
+	
+	bool await_suspend(std::coroutine_handle<> handle) {
+		// Cancelled before queueing. Resume right away and fail in await_resume().
+		if (cancel && *cancel) {
+			error = std::make_exception_ptr(NymphCastCancelled());
+			return false;
+		}
+		
+		bool queued = client.runAsync([this, handle]() {
+			if (cancel && *cancel) { error = std::make_exception_ptr(NymphCastCancelled()); }
+			else {
+				try { result = call(); }
+				catch (...) { error = std::current_exception(); }
+			}
+			
+			if (executor) { executor([handle]() { handle.resume(); }); }
+			else { handle.resume(); }
+		});
+		
+		// The client is shutting down. Resume right away and fail in await_resume().
+		if (!queued) {
+			error = std::make_exception_ptr(std::runtime_error("NymphCast client is shutting down."));
+		}
+		
+		return queued;
+	}
+	
+	T await_resume() {
+		if (error) { std::rethrow_exception(error); }
+		return std::move(result);
+	}
+};
+
+
+class NymphCastCoroClient {
+	NymphCastClient& client;
+	NymphExecutorFunction executor;
+	
+	template<typename T>
+	NymphCastAwaitable<T> await(std::function<T()> call, NymphCancelFlag cancel) {
+		return NymphCastAwaitable<T>(client, executor, std::move(call), std::move(cancel));
+	}
+	
+public:
+	/**
+		Wrap a client instance. If no executor is provided, coroutines are resumed on the
+		client's task pool thread which performed the call.
+	*/
+	NymphCastCoroClient(NymphCastClient& client, 
+							NymphExecutorFunction executor = NymphExecutorFunction()) :
+		client(client), executor(std::move(executor)) { }
+	
+	// Connection.
+	NymphCastAwaitable<NymphConnectResult> connectServerAsync(std::string ip, uint32_t port, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<NymphConnectResult>([this, ip, port]() {
+			NymphConnectResult res;
+			res.remote.ipv4 = ip;
+			res.remote.port = port;
+			res.connected = client.connectServer(ip, port, res.handle);
+			return res;
+		}, cancel);
+	}
+	
+	NymphCastAwaitable<bool> disconnectServerAsync(uint32_t handle, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<bool>([this, handle]() { return client.disconnectServer(handle); }, cancel);
+	}
+	
+	// Control.
+	NymphCastAwaitable<uint8_t> volumeSetAsync(uint32_t handle, uint8_t volume, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<uint8_t>([this, handle, volume]() { 
+			return client.volumeSet(handle, volume); 
+		}, cancel);
+	}
+	
+	NymphCastAwaitable<uint8_t> volumeUpAsync(uint32_t handle, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<uint8_t>([this, handle]() { return client.volumeUp(handle); }, cancel);
+	}
+	
+	NymphCastAwaitable<uint8_t> volumeDownAsync(uint32_t handle, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<uint8_t>([this, handle]() { return client.volumeDown(handle); }, cancel);
+	}
+	
+	NymphCastAwaitable<uint8_t> volumeMuteAsync(uint32_t handle, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<uint8_t>([this, handle]() { return client.volumeMute(handle); }, cancel);
+	}
+	
+	NymphCastAwaitable<uint8_t> playbackStartAsync(uint32_t handle, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<uint8_t>([this, handle]() { return client.playbackStart(handle); }, cancel);
+	}
+	
+	NymphCastAwaitable<uint8_t> playbackStopAsync(uint32_t handle, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<uint8_t>([this, handle]() { return client.playbackStop(handle); }, cancel);
+	}
+	
+	NymphCastAwaitable<uint8_t> playbackPauseAsync(uint32_t handle, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<uint8_t>([this, handle]() { return client.playbackPause(handle); }, cancel);
+	}
+	
+	NymphCastAwaitable<uint8_t> playbackSeekAsync(uint32_t handle, NymphSeekType type, 
+							uint64_t value, NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<uint8_t>([this, handle, type, value]() { 
+			return client.playbackSeek(handle, type, value); 
+		}, cancel);
+	}
+	
+	NymphCastAwaitable<bool> castUrlAsync(uint32_t handle, std::string url, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<bool>([this, handle, url]() mutable { 
+			return client.castUrl(handle, url); 
+		}, cancel);
+	}
+	
+	// Status.
+	NymphCastAwaitable<NymphPlaybackStatus> playbackStatusAsync(uint32_t handle, 
+							long timeout = 0, NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<NymphPlaybackStatus>([this, handle, timeout]() { 
+			return client.playbackStatus(handle, timeout); 
+		}, cancel);
+	}
+	
+	// The cancel flag is also passed on to playbackStatusAll(), which stops requesting the 
+	// status from the remaining remotes once it is set.
+	NymphCastAwaitable<std::vector<NymphStatusResult> > playbackStatusAllAsync(
+							std::vector<uint32_t> handles, uint32_t deadline = 1000, 
+							uint32_t maxInFlight = 8, NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<std::vector<NymphStatusResult> >(
+								[this, handles, deadline, maxInFlight, cancel]() { 
+			return client.playbackStatusAll(handles, deadline, maxInFlight, cancel); 
+		}, cancel);
+	}
+	
+	// Shares.
+	NymphCastAwaitable<std::vector<NymphMediaFile> > getSharesAsync(NymphCastRemote mediaserver, 
+							long timeout = 0, NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<std::vector<NymphMediaFile> >([this, mediaserver, timeout]() { 
+			return client.getShares(mediaserver, timeout); 
+		}, cancel);
+	}
+	
+	NymphCastAwaitable<uint8_t> playShareAsync(NymphMediaFile file, 
+												std::vector<NymphCastRemote> receivers, 
+												NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<uint8_t>([this, file, receivers]() { 
+			return client.playShare(file, receivers); 
+		}, cancel);
+	}
+	
+	NymphCastAwaitable<std::vector<NymphMediaFile> > getReceiverSharesAsync(uint32_t handle, 
+							long timeout = 0, NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<std::vector<NymphMediaFile> >([this, handle, timeout]() { 
+			return client.getReceiverShares(handle, timeout); 
+		}, cancel);
+	}
+	
+	NymphCastAwaitable<bool> playReceiverShareAsync(uint32_t handle, NymphMediaFile file, 
+										NymphCancelFlag cancel = NymphCancelFlag()) {
+		return await<bool>([this, handle, file]() { 
+			return client.playReceiverShare(handle, file); 
+		}, cancel);
+	}
+};
+
+
+#endif